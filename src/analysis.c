@@ -0,0 +1,518 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <sndfile.h>
+#include "analysis.h"
+#include "audio_block.h"
+#include "audio_processing.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Samples at or above this magnitude count as clipped (largest 16-bit PCM value)
+#define CLIP_LEVEL (32767.0f / 32768.0f)
+
+// EBU R128 gating thresholds
+#define LOUDNESS_ABSOLUTE_GATE -70.0
+#define LOUDNESS_RELATIVE_GATE -10.0
+
+// Gating blocks are 400 ms long with 75% overlap, i.e. made of four 100 ms steps
+#define LOUDNESS_STEPS_PER_BLOCK 4
+
+// Gains closer to unity than this are treated as 0 dB
+#define UNITY_GAIN_EPSILON_DB 1e-6
+
+// Second-order IIR section used for the K-weighting pre-filter
+typedef struct {
+    double b0, b1, b2, a1, a2;
+    double z1, z2;
+} Biquad;
+
+// Running statistics of one channel
+typedef struct {
+    Biquad shelf;
+    Biquad highpass;
+    float peak;
+    double sum;
+    double sum_squares;
+    sf_count_t clips;
+    double *step_energy; // K-weighted energy of every 100 ms step touched by the current block
+} ChannelState;
+
+// Function to set up the ITU-R BS.1770 high-shelf and high-pass stages for a sample rate
+static void k_weighting_init(Biquad *shelf, Biquad *highpass, int samplerate) {
+    const double pi = 3.14159265358979323846;
+
+    // Stage 1: high shelf (+4 dB above ~1.7 kHz)
+    double f0 = 1681.974450955533;
+    double gain = 3.999843853973347;
+    double q = 0.7071752369554196;
+    double k = tan(pi * f0 / samplerate);
+    double vh = pow(10.0, gain / 20.0);
+    double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    shelf->b0 = (vh + vb * k / q + k * k) / a0;
+    shelf->b1 = 2.0 * (k * k - vh) / a0;
+    shelf->b2 = (vh - vb * k / q + k * k) / a0;
+    shelf->a1 = 2.0 * (k * k - 1.0) / a0;
+    shelf->a2 = (1.0 - k / q + k * k) / a0;
+    shelf->z1 = shelf->z2 = 0.0;
+
+    // Stage 2: high pass (~38 Hz)
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = tan(pi * f0 / samplerate);
+    a0 = 1.0 + k / q + k * k;
+    highpass->b0 = 1.0;
+    highpass->b1 = -2.0;
+    highpass->b2 = 1.0;
+    highpass->a1 = 2.0 * (k * k - 1.0) / a0;
+    highpass->a2 = (1.0 - k / q + k * k) / a0;
+    highpass->z1 = highpass->z2 = 0.0;
+}
+
+// Function to run one sample through a biquad (transposed direct form II)
+static double biquad_process(Biquad *filter, double x) {
+    double y = filter->b0 * x + filter->z1;
+    filter->z1 = filter->b1 * x - filter->a1 * y + filter->z2;
+    filter->z2 = filter->b2 * x - filter->a2 * y;
+    return y;
+}
+
+// Function to get the BS.1770 weight of a channel (LFE excluded, surrounds +1.5 dB in 5.1)
+static double channel_weight(int channel, int channels) {
+    if (channels == 6) {
+        if (channel == 3) return 0.0;
+        if (channel >= 4) return 1.41;
+    }
+    return 1.0;
+}
+
+// Function to accumulate peak, sum, sum of squares and clip count of a lane
+static void lane_levels(const float *lane, sf_count_t count, ChannelState *state) {
+    sf_count_t i = 0;
+    float peak = state->peak;
+    double sum = 0.0;
+    double sum_squares = 0.0;
+    sf_count_t clips = 0;
+
+#if defined(__SSE2__)
+    static const int set_bits[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 clip_level = _mm_set1_ps(CLIP_LEVEL);
+    __m128 peak_vector = _mm_set1_ps(peak);
+    __m128d sum_vector = _mm_setzero_pd();
+    __m128d squares_vector = _mm_setzero_pd();
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(lane + i);
+        __m128 magnitude = _mm_and_ps(x, abs_mask);
+        peak_vector = _mm_max_ps(peak_vector, magnitude);
+        clips += set_bits[_mm_movemask_ps(_mm_cmpge_ps(magnitude, clip_level))];
+
+        // Sums are kept in double precision so hour-long files do not lose the DC term
+        __m128d low = _mm_cvtps_pd(x);
+        __m128d high = _mm_cvtps_pd(_mm_movehl_ps(x, x));
+        sum_vector = _mm_add_pd(sum_vector, _mm_add_pd(low, high));
+        squares_vector = _mm_add_pd(squares_vector, _mm_add_pd(_mm_mul_pd(low, low), _mm_mul_pd(high, high)));
+    }
+
+    float peaks[4];
+    double sums[2];
+    double squares[2];
+    _mm_storeu_ps(peaks, peak_vector);
+    _mm_storeu_pd(sums, sum_vector);
+    _mm_storeu_pd(squares, squares_vector);
+    for (int j = 0; j < 4; ++j) {
+        if (peaks[j] > peak) peak = peaks[j];
+    }
+    sum = sums[0] + sums[1];
+    sum_squares = squares[0] + squares[1];
+#endif
+
+    for (; i < count; ++i) {
+        float magnitude = fabsf(lane[i]);
+        if (magnitude > peak) peak = magnitude;
+        if (magnitude >= CLIP_LEVEL) clips++;
+        sum += lane[i];
+        sum_squares += (double)lane[i] * lane[i];
+    }
+
+    state->peak = peak;
+    state->sum += sum;
+    state->sum_squares += sum_squares;
+    state->clips += clips;
+}
+
+// Function to K-weight a lane and add its energy to the 100 ms steps it covers
+static void lane_loudness(const float *lane, sf_count_t count, sf_count_t position, sf_count_t step, ChannelState *state) {
+    const sf_count_t first_step = position / step;
+    sf_count_t i = 0;
+
+    while (i < count) {
+        const sf_count_t step_index = (position + i) / step;
+        sf_count_t step_end = (step_index + 1) * step - position;
+        if (step_end > count) step_end = count;
+
+        double energy = 0.0;
+        for (; i < step_end; ++i) {
+            double y = biquad_process(&state->highpass, biquad_process(&state->shelf, lane[i]));
+            energy += y * y;
+        }
+        state->step_energy[step_index - first_step] += energy;
+    }
+}
+
+// Function to compute the gated integrated loudness from the 100 ms step energies
+static double integrated_loudness(const double *steps, sf_count_t step_count, sf_count_t step) {
+    const sf_count_t block_count = step_count - LOUDNESS_STEPS_PER_BLOCK + 1;
+    const double absolute_gate = pow(10.0, (LOUDNESS_ABSOLUTE_GATE + 0.691) / 10.0);
+
+    if (block_count <= 0) {
+        return -HUGE_VAL;
+    }
+
+    // First pass: mean power of the blocks above the absolute gate
+    double gated_sum = 0.0;
+    sf_count_t gated_count = 0;
+    for (sf_count_t j = 0; j < block_count; ++j) {
+        double power = (steps[j] + steps[j + 1] + steps[j + 2] + steps[j + 3]) / (double)(LOUDNESS_STEPS_PER_BLOCK * step);
+        if (power > absolute_gate) {
+            gated_sum += power;
+            gated_count++;
+        }
+    }
+    if (gated_count == 0) {
+        return -HUGE_VAL;
+    }
+
+    // Second pass: drop the blocks more than 10 LU below the absolute-gated loudness
+    const double relative_gate = gated_sum / gated_count * pow(10.0, LOUDNESS_RELATIVE_GATE / 10.0);
+    gated_sum = 0.0;
+    gated_count = 0;
+    for (sf_count_t j = 0; j < block_count; ++j) {
+        double power = (steps[j] + steps[j + 1] + steps[j + 2] + steps[j + 3]) / (double)(LOUDNESS_STEPS_PER_BLOCK * step);
+        if (power > absolute_gate && power > relative_gate) {
+            gated_sum += power;
+            gated_count++;
+        }
+    }
+    if (gated_count == 0) {
+        return -HUGE_VAL;
+    }
+
+    return -0.691 + 10.0 * log10(gated_sum / gated_count);
+}
+
+// Function to release the per-channel arrays of an analysis
+void audio_analysis_free(AudioAnalysis *analysis) {
+    free(analysis->peak);
+    free(analysis->rms);
+    free(analysis->dc_offset);
+    free(analysis->clip_count);
+    analysis->peak = NULL;
+    analysis->rms = NULL;
+    analysis->dc_offset = NULL;
+    analysis->clip_count = NULL;
+}
+
+// Function to measure a file in one streaming pass
+int analyze_audio_file(const char *input_path, AudioAnalysis *analysis) {
+    SF_INFO sfinfo = {0};
+
+    memset(analysis, 0, sizeof(*analysis));
+
+    SNDFILE *input_file = sf_open(input_path, SFM_READ, &sfinfo);
+    if (!input_file) {
+        fprintf(stderr, "Error: Could not open input file %s\n", input_path);
+        return -1;
+    }
+
+    const int channels = sfinfo.channels;
+    const sf_count_t step = (sfinfo.samplerate >= 10) ? sfinfo.samplerate / 10 : 1;
+    const sf_count_t steps_per_block = AUDIO_BLOCK_FRAMES / step + 2;
+
+    AudioBlock block;
+    ChannelState *states = (ChannelState *)calloc(channels, sizeof(ChannelState));
+    double *step_energy = (double *)calloc((size_t)channels * steps_per_block, sizeof(double));
+    sf_count_t steps_capacity = sfinfo.frames / step + 1;
+    double *steps = (double *)malloc(steps_capacity * sizeof(double));
+    if (!states || !step_energy || !steps || audio_block_init(&block, channels, AUDIO_BLOCK_FRAMES) != 0) {
+        fprintf(stderr, "Error: Could not allocate memory for analysis.\n");
+        free(states);
+        free(step_energy);
+        free(steps);
+        sf_close(input_file);
+        return -1;
+    }
+
+    for (int ch = 0; ch < channels; ++ch) {
+        k_weighting_init(&states[ch].shelf, &states[ch].highpass, sfinfo.samplerate);
+        states[ch].step_energy = step_energy + (size_t)ch * steps_per_block;
+    }
+
+    // Stream the file: level reductions and K-weighting run per channel lane
+    sf_count_t position = 0;
+    sf_count_t step_count = 0;
+    double pending_energy = 0.0; // Weighted energy of the step that is still being filled
+    sf_count_t read_frames;
+    int status = 0;
+    while (status == 0 && (read_frames = audio_block_read(&block, input_file)) > 0) {
+        const sf_count_t first_step = position / step;
+        const sf_count_t last_step = (position + read_frames - 1) / step;
+
+        memset(step_energy, 0, (size_t)channels * steps_per_block * sizeof(double));
+
+        #pragma omp parallel for schedule(static) if (channels >= AUDIO_BLOCK_PARALLEL_CHANNELS)
+        for (int ch = 0; ch < channels; ++ch) {
+            lane_levels(block.lanes[ch], read_frames, &states[ch]);
+            lane_loudness(block.lanes[ch], read_frames, position, step, &states[ch]);
+        }
+
+        position += read_frames;
+
+        // Fold the channels together and keep every completed 100 ms step
+        for (sf_count_t s = first_step; s <= last_step; ++s) {
+            for (int ch = 0; ch < channels; ++ch) {
+                pending_energy += channel_weight(ch, channels) * states[ch].step_energy[s - first_step];
+            }
+            if ((s + 1) * step <= position) {
+                if (step_count == steps_capacity) {
+                    // The capacity only grows once the larger buffer exists
+                    double *grown = (double *)realloc(steps, 2 * steps_capacity * sizeof(double));
+                    if (!grown) {
+                        fprintf(stderr, "Error: Could not allocate memory for analysis.\n");
+                        status = -1;
+                        break;
+                    }
+                    steps = grown;
+                    steps_capacity *= 2;
+                }
+                steps[step_count++] = pending_energy;
+                pending_energy = 0.0;
+            }
+        }
+    }
+
+    sf_close(input_file);
+
+    if (status != 0) {
+        audio_block_free(&block);
+        free(states);
+        free(step_energy);
+        free(steps);
+        return -1;
+    }
+
+    analysis->channels = channels;
+    analysis->samplerate = sfinfo.samplerate;
+    analysis->frames = position;
+    analysis->peak = (double *)calloc(channels, sizeof(double));
+    analysis->rms = (double *)calloc(channels, sizeof(double));
+    analysis->dc_offset = (double *)calloc(channels, sizeof(double));
+    analysis->clip_count = (sf_count_t *)calloc(channels, sizeof(sf_count_t));
+    if (!analysis->peak || !analysis->rms || !analysis->dc_offset || !analysis->clip_count) {
+        fprintf(stderr, "Error: Could not allocate memory for analysis.\n");
+        audio_analysis_free(analysis);
+        audio_block_free(&block);
+        free(states);
+        free(step_energy);
+        free(steps);
+        return -1;
+    }
+
+    for (int ch = 0; ch < channels; ++ch) {
+        analysis->peak[ch] = states[ch].peak;
+        analysis->rms[ch] = (position > 0) ? sqrt(states[ch].sum_squares / position) : 0.0;
+        analysis->dc_offset[ch] = (position > 0) ? states[ch].sum / position : 0.0;
+        analysis->clip_count[ch] = states[ch].clips;
+    }
+    analysis->integrated_loudness = integrated_loudness(steps, step_count, step);
+
+    // Clean up
+    audio_block_free(&block);
+    free(states);
+    free(step_energy);
+    free(steps);
+
+    return 0;
+}
+
+// Function to convert a linear level to dBFS
+static double level_to_db(double level) {
+    return (level > 0.0) ? 20.0 * log10(level) : -HUGE_VAL;
+}
+
+// Function to print the analysis of a file
+int analyze_audio(const char *input_path) {
+    AudioAnalysis analysis;
+    if (analyze_audio_file(input_path, &analysis) != 0) {
+        return -1;
+    }
+
+    printf("Analysis of %s (%d channels, %d Hz, %.1f seconds):\n", input_path, analysis.channels,
+           analysis.samplerate, (double)analysis.frames / analysis.samplerate);
+    for (int ch = 0; ch < analysis.channels; ++ch) {
+        printf("    Channel %d: peak %.2f dBFS, RMS %.2f dBFS, DC offset %.6f, clipped samples %lld\n", ch + 1,
+               level_to_db(analysis.peak[ch]), level_to_db(analysis.rms[ch]), analysis.dc_offset[ch],
+               (long long)analysis.clip_count[ch]);
+    }
+    printf("    Integrated loudness: %.1f LUFS\n", analysis.integrated_loudness);
+
+    audio_analysis_free(&analysis);
+    return 0;
+}
+
+// Function to compute the gain in dB that brings an analysed file to the target
+int normalize_gain_db(const AudioAnalysis *analysis, double target, NormalizeMode mode, double *gain_db) {
+    double measured;
+
+    if (mode == NORMALIZE_PEAK) {
+        double peak = 0.0;
+        for (int ch = 0; ch < analysis->channels; ++ch) {
+            if (analysis->peak[ch] > peak) peak = analysis->peak[ch];
+        }
+        measured = level_to_db(peak);
+    } else {
+        measured = analysis->integrated_loudness;
+    }
+
+    if (!isfinite(measured)) {
+        return -1;
+    }
+
+    *gain_db = target - measured;
+    return 0;
+}
+
+// Function to apply a gain in place, reading and rewriting each block of the same file
+static int apply_gain_in_place(const char *path, float gain) {
+    SF_INFO sfinfo = {0};
+
+    SNDFILE *file = sf_open(path, SFM_RDWR, &sfinfo);
+    if (!file) {
+        fprintf(stderr, "Error: Could not open %s for in-place processing\n", path);
+        return -1;
+    }
+    if (gain > 1.0f) {
+        sf_command(file, SFC_SET_CLIPPING, NULL, SF_TRUE);
+    }
+
+    AudioBlock block;
+    if (audio_block_init(&block, sfinfo.channels, AUDIO_BLOCK_FRAMES) != 0) {
+        fprintf(stderr, "Error: Could not allocate memory for audio data.\n");
+        sf_close(file);
+        return -1;
+    }
+
+    sf_count_t position = 0;
+    sf_count_t read_frames;
+    int status = 0;
+    while ((read_frames = audio_block_read(&block, file)) > 0) {
+        audio_block_apply_gain(&block, gain);
+
+        // Rewind over the block just read, overwrite it and move on to the next one
+        sf_seek(file, position, SEEK_SET);
+        if (audio_block_write(&block, file) != read_frames) {
+            fprintf(stderr, "Error: Could not write all samples to %s\n", path);
+            status = -1;
+            break;
+        }
+        position += read_frames;
+        sf_seek(file, position, SEEK_SET);
+    }
+
+    audio_block_free(&block);
+    sf_close(file);
+    return status;
+}
+
+// Function to apply a constant gain to a file
+int apply_gain_to_file(const char *input_path, const char *output_path, double gain_db) {
+    const int in_place = (strcmp(input_path, output_path) == 0);
+
+    // Unity gain leaves the samples untouched, so the file bytes can be copied as they are
+    if (fabs(gain_db) < UNITY_GAIN_EPSILON_DB) {
+        return in_place ? 0 : copy_file_raw(input_path, output_path);
+    }
+
+    // Files shared through hard links (e.g. with the result cache) are rewritten as a new file instead
+    const float gain = (float)pow(10.0, gain_db / 20.0);
+    struct stat file_stat;
+    if (in_place && stat(input_path, &file_stat) == 0 && file_stat.st_nlink <= 1) {
+        return apply_gain_in_place(input_path, gain);
+    }
+
+    SF_INFO sfinfo = {0};
+    SNDFILE *input_file = sf_open(input_path, SFM_READ, &sfinfo);
+    if (!input_file) {
+        fprintf(stderr, "Error: Could not open input file %s\n", input_path);
+        return -1;
+    }
+
+    AudioBlock block;
+    if (audio_block_init(&block, sfinfo.channels, AUDIO_BLOCK_FRAMES) != 0) {
+        fprintf(stderr, "Error: Could not allocate memory for audio data.\n");
+        sf_close(input_file);
+        return -1;
+    }
+
+    OutputFile output;
+    SNDFILE *output_file = open_output_file(&output, output_path, &sfinfo);
+    if (!output_file) {
+        fprintf(stderr, "Error: Could not open output file %s\n", output_path);
+        audio_block_free(&block);
+        sf_close(input_file);
+        return -1;
+    }
+    if (gain > 1.0f) {
+        sf_command(output_file, SFC_SET_CLIPPING, NULL, SF_TRUE);
+    }
+
+    sf_count_t read_frames;
+    int status = 0;
+    while ((read_frames = audio_block_read(&block, input_file)) > 0) {
+        audio_block_apply_gain(&block, gain);
+        if (audio_block_write(&block, output_file) != read_frames) {
+            fprintf(stderr, "Error: Could not write all samples to the output file.\n");
+            status = -1;
+            break;
+        }
+    }
+
+    // Clean up
+    audio_block_free(&block);
+    sf_close(input_file);
+
+    return close_output_file(&output, status);
+}
+
+// Function to normalize a file to a loudness or peak target
+int normalize_audio(const char *input_path, const char *output_path, double target, NormalizeMode mode) {
+    AudioAnalysis analysis;
+
+    // First pass: measure
+    if (analyze_audio_file(input_path, &analysis) != 0) {
+        return -1;
+    }
+
+    double gain_db;
+    int status = normalize_gain_db(&analysis, target, mode, &gain_db);
+    audio_analysis_free(&analysis);
+    if (status != 0) {
+        fprintf(stderr, "Error: %s is silent and cannot be normalized\n", input_path);
+        return -1;
+    }
+
+    // Second pass: pure gain stage
+    if (apply_gain_to_file(input_path, output_path, gain_db) != 0) {
+        return -1;
+    }
+
+    printf("Normalized %s to %.1f %s (gain %+.2f dB) and saved to %s\n", input_path, target,
+           (mode == NORMALIZE_PEAK) ? "dBFS" : "LUFS", gain_db, output_path);
+
+    return 0;
+}
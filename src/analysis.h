@@ -0,0 +1,42 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <sndfile.h>
+
+// Per-channel level statistics and programme loudness of one audio file
+typedef struct {
+    int channels;
+    int samplerate;
+    sf_count_t frames;
+    double *peak;               // Largest absolute sample value per channel (linear)
+    double *rms;                // Root mean square per channel (linear)
+    double *dc_offset;          // Mean sample value per channel
+    sf_count_t *clip_count;     // Samples at or above full scale per channel
+    double integrated_loudness; // EBU R128 integrated loudness in LUFS (-HUGE_VAL when fully gated)
+} AudioAnalysis;
+
+// Normalization targets accepted by normalize_audio
+typedef enum {
+    NORMALIZE_LOUDNESS, // Target is integrated loudness in LUFS
+    NORMALIZE_PEAK      // Target is sample peak in dBFS
+} NormalizeMode;
+
+// Function to measure a file in one streaming pass, returns 0 on success
+int analyze_audio_file(const char *input_path, AudioAnalysis *analysis);
+
+// Function to release the per-channel arrays of an analysis
+void audio_analysis_free(AudioAnalysis *analysis);
+
+// Function to print the analysis of a file, returns 0 on success
+int analyze_audio(const char *input_path);
+
+// Function to compute the gain in dB that brings an analysed file to the target
+int normalize_gain_db(const AudioAnalysis *analysis, double target, NormalizeMode mode, double *gain_db);
+
+// Function to apply a constant gain to a file (raw copy at 0 dB, in place when both paths match)
+int apply_gain_to_file(const char *input_path, const char *output_path, double gain_db);
+
+// Function to normalize a file to a loudness or peak target (analysis pass + gain pass)
+int normalize_audio(const char *input_path, const char *output_path, double target, NormalizeMode mode);
+
+#endif // ANALYSIS_H
@@ -0,0 +1,332 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sndfile.h>
+#include "audio_block.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+// Number of frames converted per tile when (de)interleaving wide files
+#define INTERLEAVE_TILE_FRAMES 64
+
+// Function to allocate aligned memory
+static void *aligned_alloc_bytes(size_t size) {
+#if defined(_WIN32)
+    return _aligned_malloc(size, AUDIO_BLOCK_ALIGNMENT);
+#else
+    void *memory = NULL;
+    if (posix_memalign(&memory, AUDIO_BLOCK_ALIGNMENT, size) != 0) {
+        return NULL;
+    }
+    return memory;
+#endif
+}
+
+// Function to release aligned memory
+static void aligned_free_bytes(void *memory) {
+#if defined(_WIN32)
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+
+// Function to allocate a block for the given channel count and capacity
+int audio_block_init(AudioBlock *block, int channels, sf_count_t capacity) {
+    block->channels = channels;
+    block->capacity = 0;
+    block->frames = 0;
+    block->lanes = NULL;
+    block->storage = NULL;
+    block->interleaved = NULL;
+
+    if (channels <= 0 || capacity <= 0) {
+        return -1;
+    }
+
+    // Round each lane up so that every lane starts on an aligned boundary
+    const sf_count_t floats_per_alignment = AUDIO_BLOCK_ALIGNMENT / sizeof(float);
+    const sf_count_t stride = (capacity + floats_per_alignment - 1) / floats_per_alignment * floats_per_alignment;
+
+    block->lanes = (float **)malloc(channels * sizeof(float *));
+    block->storage = (float *)aligned_alloc_bytes((size_t)stride * channels * sizeof(float));
+    block->interleaved = (float *)aligned_alloc_bytes((size_t)capacity * channels * sizeof(float));
+    if (!block->lanes || !block->storage || !block->interleaved) {
+        audio_block_free(block);
+        return -1;
+    }
+
+    for (int ch = 0; ch < channels; ++ch) {
+        block->lanes[ch] = block->storage + ch * stride;
+    }
+    block->capacity = capacity;
+
+    return 0;
+}
+
+// Function to release the block buffers
+void audio_block_free(AudioBlock *block) {
+    free(block->lanes);
+    aligned_free_bytes(block->storage);
+    aligned_free_bytes(block->interleaved);
+    block->lanes = NULL;
+    block->storage = NULL;
+    block->interleaved = NULL;
+    block->capacity = 0;
+    block->frames = 0;
+}
+
+// Function to split interleaved frames into the channel lanes
+void audio_block_deinterleave(AudioBlock *block, const float *interleaved, sf_count_t frames) {
+    const int channels = block->channels;
+    sf_count_t i = 0;
+
+    if (frames > block->capacity) {
+        frames = block->capacity;
+    }
+    block->frames = frames;
+
+    if (channels == 1) {
+        for (; i < frames; ++i) {
+            block->lanes[0][i] = interleaved[i];
+        }
+        return;
+    }
+
+#if defined(__SSE2__)
+    if (channels == 2) {
+        float *left = block->lanes[0];
+        float *right = block->lanes[1];
+        for (; i + 4 <= frames; i += 4) {
+            __m128 first = _mm_loadu_ps(interleaved + 2 * i);
+            __m128 second = _mm_loadu_ps(interleaved + 2 * i + 4);
+            _mm_store_ps(left + i, _mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm_store_ps(right + i, _mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1)));
+        }
+    } else if (channels >= 4) {
+        // Wide layouts move 4 frames x 4 channels per register transpose, leftover channels go one by one
+        const sf_count_t vector_frames = frames / 4 * 4;
+        const int vector_channels = channels / 4 * 4;
+        for (sf_count_t tile = 0; tile < vector_frames; tile += INTERLEAVE_TILE_FRAMES) {
+            const sf_count_t tile_end = (tile + INTERLEAVE_TILE_FRAMES < vector_frames) ? tile + INTERLEAVE_TILE_FRAMES : vector_frames;
+            for (int ch = 0; ch < vector_channels; ch += 4) {
+                for (sf_count_t j = tile; j < tile_end; j += 4) {
+                    const float *row = interleaved + j * channels + ch;
+                    __m128 r0 = _mm_loadu_ps(row);
+                    __m128 r1 = _mm_loadu_ps(row + channels);
+                    __m128 r2 = _mm_loadu_ps(row + 2 * channels);
+                    __m128 r3 = _mm_loadu_ps(row + 3 * channels);
+                    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+                    _mm_store_ps(block->lanes[ch] + j, r0);
+                    _mm_store_ps(block->lanes[ch + 1] + j, r1);
+                    _mm_store_ps(block->lanes[ch + 2] + j, r2);
+                    _mm_store_ps(block->lanes[ch + 3] + j, r3);
+                }
+            }
+            for (int ch = vector_channels; ch < channels; ++ch) {
+                float *lane = block->lanes[ch];
+                for (sf_count_t j = tile; j < tile_end; ++j) {
+                    lane[j] = interleaved[j * channels + ch];
+                }
+            }
+        }
+        i = vector_frames;
+    }
+#endif
+
+    // Tiled transpose keeps both the source rows and the destination lanes in cache
+    for (sf_count_t tile = i; tile < frames; tile += INTERLEAVE_TILE_FRAMES) {
+        const sf_count_t tile_end = (tile + INTERLEAVE_TILE_FRAMES < frames) ? tile + INTERLEAVE_TILE_FRAMES : frames;
+        for (int ch = 0; ch < channels; ++ch) {
+            float *lane = block->lanes[ch];
+            for (sf_count_t j = tile; j < tile_end; ++j) {
+                lane[j] = interleaved[j * channels + ch];
+            }
+        }
+    }
+}
+
+// Function to merge the channel lanes back into interleaved frames
+void audio_block_interleave(const AudioBlock *block, float *interleaved) {
+    const int channels = block->channels;
+    const sf_count_t frames = block->frames;
+    sf_count_t i = 0;
+
+    if (channels == 1) {
+        for (; i < frames; ++i) {
+            interleaved[i] = block->lanes[0][i];
+        }
+        return;
+    }
+
+#if defined(__SSE2__)
+    if (channels == 2) {
+        const float *left = block->lanes[0];
+        const float *right = block->lanes[1];
+        for (; i + 4 <= frames; i += 4) {
+            __m128 l = _mm_load_ps(left + i);
+            __m128 r = _mm_load_ps(right + i);
+            _mm_storeu_ps(interleaved + 2 * i, _mm_unpacklo_ps(l, r));
+            _mm_storeu_ps(interleaved + 2 * i + 4, _mm_unpackhi_ps(l, r));
+        }
+    } else if (channels >= 4) {
+        const sf_count_t vector_frames = frames / 4 * 4;
+        const int vector_channels = channels / 4 * 4;
+        for (sf_count_t tile = 0; tile < vector_frames; tile += INTERLEAVE_TILE_FRAMES) {
+            const sf_count_t tile_end = (tile + INTERLEAVE_TILE_FRAMES < vector_frames) ? tile + INTERLEAVE_TILE_FRAMES : vector_frames;
+            for (int ch = 0; ch < vector_channels; ch += 4) {
+                for (sf_count_t j = tile; j < tile_end; j += 4) {
+                    __m128 r0 = _mm_load_ps(block->lanes[ch] + j);
+                    __m128 r1 = _mm_load_ps(block->lanes[ch + 1] + j);
+                    __m128 r2 = _mm_load_ps(block->lanes[ch + 2] + j);
+                    __m128 r3 = _mm_load_ps(block->lanes[ch + 3] + j);
+                    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+                    float *row = interleaved + j * channels + ch;
+                    _mm_storeu_ps(row, r0);
+                    _mm_storeu_ps(row + channels, r1);
+                    _mm_storeu_ps(row + 2 * channels, r2);
+                    _mm_storeu_ps(row + 3 * channels, r3);
+                }
+            }
+            for (int ch = vector_channels; ch < channels; ++ch) {
+                const float *lane = block->lanes[ch];
+                for (sf_count_t j = tile; j < tile_end; ++j) {
+                    interleaved[j * channels + ch] = lane[j];
+                }
+            }
+        }
+        i = vector_frames;
+    }
+#endif
+
+    for (sf_count_t tile = i; tile < frames; tile += INTERLEAVE_TILE_FRAMES) {
+        const sf_count_t tile_end = (tile + INTERLEAVE_TILE_FRAMES < frames) ? tile + INTERLEAVE_TILE_FRAMES : frames;
+        for (int ch = 0; ch < channels; ++ch) {
+            const float *lane = block->lanes[ch];
+            for (sf_count_t j = tile; j < tile_end; ++j) {
+                interleaved[j * channels + ch] = lane[j];
+            }
+        }
+    }
+}
+
+// Function to read up to capacity frames from a file into the block
+sf_count_t audio_block_read(AudioBlock *block, SNDFILE *file) {
+    sf_count_t read_frames = sf_readf_float(file, block->interleaved, block->capacity);
+    if (read_frames < 0) {
+        read_frames = 0;
+    }
+    audio_block_deinterleave(block, block->interleaved, read_frames);
+    return read_frames;
+}
+
+// Function to write the valid frames of the block to a file
+sf_count_t audio_block_write(AudioBlock *block, SNDFILE *file) {
+    audio_block_interleave(block, block->interleaved);
+    return sf_writef_float(file, block->interleaved, block->frames);
+}
+
+// Function to multiply a single lane by a constant gain
+void lane_apply_gain(float *lane, sf_count_t count, float gain) {
+    sf_count_t i = 0;
+#if defined(__SSE2__)
+    const __m128 gain_vector = _mm_set1_ps(gain);
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(lane + i, _mm_mul_ps(_mm_loadu_ps(lane + i), gain_vector));
+    }
+#endif
+    for (; i < count; ++i) {
+        lane[i] *= gain;
+    }
+}
+
+// Function to multiply a single lane by a linear ramp start + step * i
+void lane_apply_ramp(float *lane, sf_count_t count, float start, float step) {
+    sf_count_t i = 0;
+#if defined(__SSE2__)
+    const __m128 index_step = _mm_set1_ps(4.0f);
+    const __m128 step_vector = _mm_set1_ps(step);
+    const __m128 start_vector = _mm_set1_ps(start);
+    __m128 index = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    for (; i + 4 <= count; i += 4) {
+        // Gains are recomputed from the index rather than accumulated, so long ramps do not drift
+        __m128 gain = _mm_add_ps(start_vector, _mm_mul_ps(index, step_vector));
+        _mm_storeu_ps(lane + i, _mm_mul_ps(_mm_loadu_ps(lane + i), gain));
+        index = _mm_add_ps(index, index_step);
+    }
+#endif
+    for (; i < count; ++i) {
+        lane[i] *= start + step * (float)i;
+    }
+}
+
+// Function to multiply a single lane by an exponential ramp start * ratio^i
+void lane_apply_exp_ramp(float *lane, sf_count_t count, float start, float ratio) {
+    sf_count_t i = 0;
+    float gain = start;
+#if defined(__SSE2__)
+    if (count >= 4) {
+        const float ratio2 = ratio * ratio;
+        const __m128 ratio4 = _mm_set1_ps(ratio2 * ratio2);
+        __m128 gains = _mm_set_ps(start * ratio2 * ratio, start * ratio2, start * ratio, start);
+        for (; i + 4 <= count; i += 4) {
+            _mm_storeu_ps(lane + i, _mm_mul_ps(_mm_loadu_ps(lane + i), gains));
+            gains = _mm_mul_ps(gains, ratio4);
+        }
+        gain = _mm_cvtss_f32(gains);
+    }
+#endif
+    for (; i < count; ++i) {
+        lane[i] *= gain;
+        gain *= ratio;
+    }
+}
+
+// Function to multiply every lane by a constant gain
+void audio_block_apply_gain(AudioBlock *block, float gain) {
+    const int channels = block->channels;
+
+    #pragma omp parallel for schedule(static) if (channels >= AUDIO_BLOCK_PARALLEL_CHANNELS)
+    for (int ch = 0; ch < channels; ++ch) {
+        lane_apply_gain(block->lanes[ch], block->frames, gain);
+    }
+}
+
+// Function to multiply frames [offset, offset + count) by a linear ramp start + step * i
+void audio_block_apply_ramp(AudioBlock *block, sf_count_t offset, sf_count_t count, float start, float step) {
+    const int channels = block->channels;
+
+    if (offset < 0 || offset >= block->frames || count <= 0) {
+        return;
+    }
+    if (offset + count > block->frames) {
+        count = block->frames - offset;
+    }
+
+    #pragma omp parallel for schedule(static) if (channels >= AUDIO_BLOCK_PARALLEL_CHANNELS)
+    for (int ch = 0; ch < channels; ++ch) {
+        lane_apply_ramp(block->lanes[ch] + offset, count, start, step);
+    }
+}
+
+// Function to multiply frames [offset, offset + count) by an exponential ramp start * ratio^i
+void audio_block_apply_exp_ramp(AudioBlock *block, sf_count_t offset, sf_count_t count, float start, float ratio) {
+    const int channels = block->channels;
+
+    if (offset < 0 || offset >= block->frames || count <= 0) {
+        return;
+    }
+    if (offset + count > block->frames) {
+        count = block->frames - offset;
+    }
+
+    #pragma omp parallel for schedule(static) if (channels >= AUDIO_BLOCK_PARALLEL_CHANNELS)
+    for (int ch = 0; ch < channels; ++ch) {
+        lane_apply_exp_ramp(block->lanes[ch] + offset, count, start, ratio);
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef AUDIO_BLOCK_H
+#define AUDIO_BLOCK_H
+
+#include <sndfile.h>
+
+// Default number of frames held by a processing block
+#define AUDIO_BLOCK_FRAMES 4096
+
+// Alignment of every channel lane in bytes (wide enough for AVX loads)
+#define AUDIO_BLOCK_ALIGNMENT 32
+
+// Channel count from which per-channel stages are spread across threads
+#define AUDIO_BLOCK_PARALLEL_CHANNELS 8
+
+// Planar block of audio: one contiguous, aligned lane of samples per channel.
+// Files are read and written interleaved, the block converts at the I/O boundary
+// so that every stage works on lanes[ch][0 .. frames).
+typedef struct {
+    int channels;
+    sf_count_t capacity;   // Frames each lane can hold
+    sf_count_t frames;     // Frames currently valid
+    float **lanes;         // lanes[ch] points into storage
+    float *storage;        // Single aligned allocation backing all lanes
+    float *interleaved;    // Scratch buffer for file I/O (capacity * channels samples)
+} AudioBlock;
+
+// Function to allocate a block for the given channel count and capacity
+int audio_block_init(AudioBlock *block, int channels, sf_count_t capacity);
+
+// Function to release the block buffers
+void audio_block_free(AudioBlock *block);
+
+// Function to split interleaved frames into the channel lanes
+void audio_block_deinterleave(AudioBlock *block, const float *interleaved, sf_count_t frames);
+
+// Function to merge the channel lanes back into interleaved frames
+void audio_block_interleave(const AudioBlock *block, float *interleaved);
+
+// Function to read up to capacity frames from a file into the block, returns the frame count
+sf_count_t audio_block_read(AudioBlock *block, SNDFILE *file);
+
+// Function to write the valid frames of the block to a file, returns the frame count
+sf_count_t audio_block_write(AudioBlock *block, SNDFILE *file);
+
+// Function to multiply every lane by a constant gain
+void audio_block_apply_gain(AudioBlock *block, float gain);
+
+// Function to multiply frames [offset, offset + count) by a linear ramp start + step * i
+void audio_block_apply_ramp(AudioBlock *block, sf_count_t offset, sf_count_t count, float start, float step);
+
+// Function to multiply frames [offset, offset + count) by an exponential ramp start * ratio^i
+void audio_block_apply_exp_ramp(AudioBlock *block, sf_count_t offset, sf_count_t count, float start, float ratio);
+
+// Function to multiply a single lane by a constant gain
+void lane_apply_gain(float *lane, sf_count_t count, float gain);
+
+// Function to multiply a single lane by a linear ramp start + step * i
+void lane_apply_ramp(float *lane, sf_count_t count, float start, float step);
+
+// Function to multiply a single lane by an exponential ramp start * ratio^i
+void lane_apply_exp_ramp(float *lane, sf_count_t count, float start, float ratio);
+
+#endif // AUDIO_BLOCK_H
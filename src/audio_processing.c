@@ -2,8 +2,17 @@
 #include <sndfile.h>
 #include <stdlib.h>
 #include "audio_processing.h"
+#include "channel_matrix.h"
+#include "audio_block.h"
 #include <stdint.h> // For SIZE_MAX
 
+#if defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
 // Function to get the length of an audio file in seconds
 double get_audio_length(const char *filepath) {
     SF_INFO info;
@@ -25,15 +34,101 @@ double get_audio_length(const char *filepath) {
     return length;
 }
 
+// Function to build a temporary path next to a destination, unique to this process
+void output_temp_path(const char *output_path, char *temp_path, size_t size) {
+    snprintf(temp_path, size, "%s.%d.tmp", output_path, (int)getpid());
+}
+
+// Function to move a finished temporary file over its destination
+int replace_file(const char *temp_path, const char *output_path) {
+#if defined(_WIN32)
+    remove(output_path); // rename does not replace an existing file on Windows
+#endif
+    if (rename(temp_path, output_path) != 0) {
+        fprintf(stderr, "Error: Could not move %s to %s\n", temp_path, output_path);
+        remove(temp_path);
+        return -1;
+    }
+
+    // rename() succeeds without doing anything when both names are hard links to one file
+    remove(temp_path);
+    return 0;
+}
+
+// Function to create an output audio file under a temporary name next to its destination
+SNDFILE *open_output_file(OutputFile *output, const char *output_path, SF_INFO *info) {
+    snprintf(output->path, sizeof(output->path), "%s", output_path);
+    output_temp_path(output_path, output->temp_path, sizeof(output->temp_path));
+    output->file = sf_open(output->temp_path, SFM_WRITE, info);
+    return output->file;
+}
+
+// Function to close an output file, moving it over the destination on success and discarding it otherwise
+int close_output_file(OutputFile *output, int status) {
+    if (output->file) {
+        sf_close(output->file);
+        output->file = NULL;
+    }
+
+    // The destination is only touched once the new file is complete, so it may also be one of the inputs
+    if (status != 0) {
+        remove(output->temp_path);
+        return -1;
+    }
+    return replace_file(output->temp_path, output->path);
+}
+
+// Function to copy a file byte for byte
+int copy_file_raw(const char *input_path, const char *output_path) {
+    FILE *input_file = fopen(input_path, "rb");
+    if (!input_file) {
+        fprintf(stderr, "Error: Could not open input file %s\n", input_path);
+        return -1;
+    }
+
+    char temp_path[512];
+    output_temp_path(output_path, temp_path, sizeof(temp_path));
+    FILE *output_file = fopen(temp_path, "wb");
+    if (!output_file) {
+        fprintf(stderr, "Error: Could not open output file %s\n", output_path);
+        fclose(input_file);
+        return -1;
+    }
+
+    // Copy in large chunks, no decoding involved
+    char buffer[65536];
+    size_t read_count;
+    int status = 0;
+    while ((read_count = fread(buffer, 1, sizeof(buffer), input_file)) > 0) {
+        if (fwrite(buffer, 1, read_count, output_file) != read_count) {
+            fprintf(stderr, "Error: Could not write all bytes to %s\n", output_path);
+            status = -1;
+            break;
+        }
+    }
+
+    // Clean up
+    fclose(input_file);
+    if (fclose(output_file) != 0) {
+        status = -1;
+    }
+    if (status != 0) {
+        remove(temp_path);
+        return -1;
+    }
+
+    return replace_file(temp_path, output_path);
+}
+
 // Function to trim audio file
-void cut_wav_segment(const char *input_path, const char *output_path, double start_time, double end_time) {
+int cut_wav_segment(const char *input_path, const char *output_path, double start_time, double end_time) {
     SF_INFO sf_info;
 
     // Open the input file
     SNDFILE *input_file = sf_open(input_path, SFM_READ, &sf_info);
     if (!input_file) {
         fprintf(stderr, "Error: Could not open input file %s\n", input_path);
-        return;
+        return -1;
     }
 
     // Calculate total number of samples and positions for cut
@@ -48,7 +143,7 @@ void cut_wav_segment(const char *input_path, const char *output_path, double sta
     if ((unsigned long long)total_samples > SIZE_MAX / sizeof(int)) {
         fprintf(stderr, "Memory allocation error: size too large.\n");
         sf_close(input_file);
-        return;
+        return -1;
     }
 
     // Allocate a buffer for the samples
@@ -56,7 +151,7 @@ void cut_wav_segment(const char *input_path, const char *output_path, double sta
     if (!buffer) {
         fprintf(stderr, "Memory allocation error.\n");
         sf_close(input_file);
-        return;
+        return -1;
     }
 
     // Read all samples from the input file
@@ -65,16 +160,17 @@ void cut_wav_segment(const char *input_path, const char *output_path, double sta
         fprintf(stderr, "Error reading samples.\n");
         free(buffer);
         sf_close(input_file);
-        return;
+        return -1;
     }
 
     // Open the output file
-    SNDFILE *output_file = sf_open(output_path, SFM_WRITE, &sf_info);
+    OutputFile output;
+    SNDFILE *output_file = open_output_file(&output, output_path, &sf_info);
     if (!output_file) {
         fprintf(stderr, "Error: Could not open output file %s\n", output_path);
         free(buffer);
         sf_close(input_file);
-        return;
+        return -1;
     }
 
     // Write the samples before the cut segment
@@ -90,46 +186,102 @@ void cut_wav_segment(const char *input_path, const char *output_path, double sta
     // Clean up
     free(buffer);
     sf_close(input_file);
-    sf_close(output_file);
+    if (close_output_file(&output, 0) != 0) {
+        return -1;
+    }
 
     printf("Segment cut from %s and saved to %s\n", input_path, output_path);
+
+    return 0;
 }
 
-// Function to add fade-in
-void add_fade_in(const char *input_path, const char *output_path, double fading_time) {
-    SF_INFO sfinfo;
+// Function to copy frames [start_frame, end_frame) of a file into a new file
+int extract_wav_frames(const char *input_path, const char *output_path, sf_count_t start_frame, sf_count_t end_frame) {
+    SF_INFO sf_info = {0};
 
-    SNDFILE *input_file = sf_open(input_path, SFM_READ, &sfinfo);
+    SNDFILE *input_file = sf_open(input_path, SFM_READ, &sf_info);
+    if (!input_file) {
+        fprintf(stderr, "Error: Could not open input file %s\n", input_path);
+        return -1;
+    }
 
-    if (fading_time < 0) {
-        fprintf(stderr, "Error: insufficient time argument %s\n", input_path);
-        return;
+    // Clamp values to file bounds
+    if (start_frame < 0) start_frame = 0;
+    if (end_frame > sf_info.frames) end_frame = sf_info.frames;
+    if (start_frame > end_frame) start_frame = end_frame;
+
+    if (start_frame > 0 && sf_seek(input_file, start_frame, SEEK_SET) < 0) {
+        fprintf(stderr, "Error: Could not seek in input file %s\n", input_path);
+        sf_close(input_file);
+        return -1;
     }
 
-    if (!input_file) {
-        fprintf(stderr, "Error: Could not open input file %s\n", input_path);
-        return;
+    OutputFile output;
+    SNDFILE *output_file = open_output_file(&output, output_path, &sf_info);
+    if (!output_file) {
+        fprintf(stderr, "Error: Could not open output file %s\n", output_path);
+        sf_close(input_file);
+        return -1;
     }
 
-    // Allocate a buffer to hold the entire audio file
-    const sf_count_t total_samples = sfinfo.frames * sfinfo.channels;
-    float *buffer = (float *)malloc(total_samples * sizeof(float));
+    // Integer reads keep PCM (32-bit included) bit-exact like cut_wav_segment, float sources go through doubles
+    const int subtype = sf_info.format & SF_FORMAT_SUBMASK;
+    const int float_source = (subtype == SF_FORMAT_FLOAT || subtype == SF_FORMAT_DOUBLE);
+
+    // Allocate a buffer for reading chunks of data
+    const sf_count_t chunk_frames = 4096;
+    void *buffer = malloc(chunk_frames * sf_info.channels * (float_source ? sizeof(double) : sizeof(int)));
     if (!buffer) {
-        fprintf(stderr, "Error: Could not allocate memory for audio data.\n");
+        fprintf(stderr, "Error: Could not allocate memory for buffer.\n");
         sf_close(input_file);
-        return;
+        close_output_file(&output, -1);
+        return -1;
     }
 
-    // Read all samples from the input file
-    const sf_count_t read_count = sf_read_float(input_file, buffer, total_samples);
-    if (read_count != total_samples) {
-        fprintf(stderr, "Error: Could not read all samples from the input file.\n");
-        free(buffer);
-        sf_close(input_file);
-        return;
+    // Stream only the requested frames
+    sf_count_t remaining = end_frame - start_frame;
+    int status = 0;
+    while (remaining > 0) {
+        sf_count_t wanted = (remaining < chunk_frames) ? remaining : chunk_frames;
+        sf_count_t read_frames = float_source ? sf_readf_double(input_file, (double *)buffer, wanted)
+                                              : sf_readf_int(input_file, (int *)buffer, wanted);
+        if (read_frames <= 0) {
+            break;
+        }
+        sf_count_t written_frames = float_source ? sf_writef_double(output_file, (const double *)buffer, read_frames)
+                                                 : sf_writef_int(output_file, (const int *)buffer, read_frames);
+        if (written_frames != read_frames) {
+            fprintf(stderr, "Error: Could not write all samples to the output file.\n");
+            status = -1;
+            break;
+        }
+        remaining -= read_frames;
     }
+
+    // Clean up
+    free(buffer);
     sf_close(input_file);
 
+    return close_output_file(&output, status);
+}
+
+// Function to add fade-in
+int add_fade_in(const char *input_path, const char *output_path, double fading_time) {
+    SF_INFO sfinfo;
+
+    SNDFILE *input_file = sf_open(input_path, SFM_READ, &sfinfo);
+
+    if (fading_time < 0) {
+        fprintf(stderr, "Error: insufficient time argument %s\n", input_path);
+        if (input_file) sf_close(input_file);
+        return -1;
+    }
+
+    if (!input_file) {
+        fprintf(stderr, "Error: Could not open input file %s\n", input_path);
+        return -1;
+    }
+
     double file_duration = (double)sfinfo.frames / sfinfo.samplerate;
     if (fading_time > file_duration) {
         fprintf(stderr, "Warning: Fade-in time exceeds file duration. Adjusting fade-in time to file duration (%.1f seconds).\n", file_duration);
@@ -139,69 +291,70 @@ void add_fade_in(const char *input_path, const char *output_path, double fading_
     // Calculate the number of samples affected by the fade-in
     const sf_count_t fade_samples = (sf_count_t)(fading_time * sfinfo.samplerate);
 
-    // Apply the fade-in effect
-    for (sf_count_t i = 0; i < fade_samples; ++i) {
-        const float fade_factor = (float)i / (float)fade_samples;
-        for (int ch = 0; ch < sfinfo.channels; ++ch) {
-            buffer[i * sfinfo.channels + ch] *= fade_factor;
-        }
+    // Allocate a planar block for streaming the file
+    AudioBlock block;
+    if (audio_block_init(&block, sfinfo.channels, AUDIO_BLOCK_FRAMES) != 0) {
+        fprintf(stderr, "Error: Could not allocate memory for audio data.\n");
+        sf_close(input_file);
+        return -1;
     }
 
-    // Open the output audio file
-    SNDFILE *output_file = sf_open(output_path, SFM_WRITE, &sfinfo);
+    // Open the output audio file (written next to the destination, so the input may be overwritten)
+    OutputFile output;
+    SNDFILE *output_file = open_output_file(&output, output_path, &sfinfo);
     if (!output_file) {
         fprintf(stderr, "Error: Could not open output file %s\n", output_path);
-        free(buffer);
-        return;
+        audio_block_free(&block);
+        sf_close(input_file);
+        return -1;
     }
 
-    // Write the modified audio data to the output file
-    sf_count_t write_count = sf_write_float(output_file, buffer, total_samples);
-    if (write_count != total_samples) {
-        fprintf(stderr, "Error: Could not write all samples to the output file.\n");
+    // Apply the fade-in effect block by block, frame i is scaled by i / fade_samples
+    sf_count_t position = 0;
+    sf_count_t read_frames;
+    int status = 0;
+    while ((read_frames = audio_block_read(&block, input_file)) > 0) {
+        if (position < fade_samples) {
+            audio_block_apply_ramp(&block, 0, fade_samples - position,
+                                   (float)position / (float)fade_samples, 1.0f / (float)fade_samples);
+        }
+
+        if (audio_block_write(&block, output_file) != read_frames) {
+            fprintf(stderr, "Error: Could not write all samples to the output file.\n");
+            status = -1;
+            break;
+        }
+        position += read_frames;
     }
 
     // Clean up
-    sf_close(output_file);
-    free(buffer);
+    sf_close(input_file);
+    audio_block_free(&block);
+    if (close_output_file(&output, status) != 0) {
+        return -1;
+    }
 
     printf("Fade-in added to first %d seconds of %s and saved to %s\n", (int) fading_time, input_path, output_path);
+
+    return 0;
 }
 
 // Function to add fade-out
-void add_fade_out(const char *input_path, const char *output_path, double fading_time) {
+int add_fade_out(const char *input_path, const char *output_path, double fading_time) {
     SF_INFO sfinfo;
 
     SNDFILE *input_file = sf_open(input_path, SFM_READ, &sfinfo);
 
     if (fading_time < 0) {
         fprintf(stderr, "Error: insufficient time argument %s\n", input_path);
-        return;
+        if (input_file) sf_close(input_file);
+        return -1;
     }
 
     if (!input_file) {
         fprintf(stderr, "Error: Could not open input file %s\n", input_path);
-        return;
-    }
-
-    // Allocate a buffer to hold the entire audio file
-    sf_count_t total_samples = sfinfo.frames * sfinfo.channels;
-    float *buffer = (float *)malloc(total_samples * sizeof(float));
-    if (!buffer) {
-        fprintf(stderr, "Error: Could not allocate memory for audio data.\n");
-        sf_close(input_file);
-        return;
-    }
-
-    // Read all samples from the input file
-    sf_count_t read_count = sf_read_float(input_file, buffer, total_samples);
-    if (read_count != total_samples) {
-        fprintf(stderr, "Error: Could not read all samples from the input file.\n");
-        free(buffer);
-        sf_close(input_file);
-        return;
+        return -1;
     }
-    sf_close(input_file);
 
     // Check if fade-out duration exceeds the audio file duration
     double file_duration = (double)sfinfo.frames / sfinfo.samplerate;
@@ -213,80 +366,158 @@ void add_fade_out(const char *input_path, const char *output_path, double fading
     // Calculate the number of samples affected by the fade-out
     sf_count_t fade_samples = (sf_count_t)(fading_time * sfinfo.samplerate);
 
-    // Apply the fade-out effect
     sf_count_t start_fade_index = sfinfo.frames - fade_samples;
     if (start_fade_index < 0) start_fade_index = 0; // Edge case: small files
 
-    for (sf_count_t i = start_fade_index; i < sfinfo.frames; ++i) {
-        float fade_factor = (float)(sfinfo.frames - i) / (float)fade_samples;
-        if (fade_factor < 0) fade_factor = 0; // Just in case
-        for (int ch = 0; ch < sfinfo.channels; ++ch) {
-            buffer[i * sfinfo.channels + ch] *= fade_factor;
-        }
+    // Allocate a planar block for streaming the file
+    AudioBlock block;
+    if (audio_block_init(&block, sfinfo.channels, AUDIO_BLOCK_FRAMES) != 0) {
+        fprintf(stderr, "Error: Could not allocate memory for audio data.\n");
+        sf_close(input_file);
+        return -1;
     }
 
-    // Open the output audio file
-    SNDFILE *output_file = sf_open(output_path, SFM_WRITE, &sfinfo);
+    // Open the output audio file (written next to the destination, so the input may be overwritten)
+    OutputFile output;
+    SNDFILE *output_file = open_output_file(&output, output_path, &sfinfo);
     if (!output_file) {
         fprintf(stderr, "Error: Could not open output file %s\n", output_path);
-        free(buffer);
-        return;
+        audio_block_free(&block);
+        sf_close(input_file);
+        return -1;
     }
 
-    // Write the modified audio data to the output file
-    sf_count_t write_count = sf_write_float(output_file, buffer, total_samples);
-    if (write_count != total_samples) {
-        fprintf(stderr, "Error: Could not write all samples to the output file.\n");
+    // Apply the fade-out effect block by block, frame i is scaled by (frames - i) / fade_samples
+    sf_count_t position = 0;
+    sf_count_t read_frames;
+    int status = 0;
+    while ((read_frames = audio_block_read(&block, input_file)) > 0) {
+        if (position + read_frames > start_fade_index) {
+            sf_count_t offset = (start_fade_index > position) ? start_fade_index - position : 0;
+            sf_count_t first = position + offset;
+            audio_block_apply_ramp(&block, offset, read_frames - offset,
+                                   (float)(sfinfo.frames - first) / (float)fade_samples, -1.0f / (float)fade_samples);
+        }
+
+        if (audio_block_write(&block, output_file) != read_frames) {
+            fprintf(stderr, "Error: Could not write all samples to the output file.\n");
+            status = -1;
+            break;
+        }
+        position += read_frames;
     }
 
     // Clean up
-    sf_close(output_file);
-    free(buffer);
+    sf_close(input_file);
+    audio_block_free(&block);
+    if (close_output_file(&output, status) != 0) {
+        return -1;
+    }
 
     printf("Fade-out added to last %d seconds of %s and saved to %s\n", (int) fading_time, input_path, output_path);
+
+    return 0;
+}
+
+// Function to stream one input file into the output, remapping its channels through a matrix file if given,
+// or the default matrix when the layouts differ
+static int append_remapped(SNDFILE *input_file, const SF_INFO *input_info, SNDFILE *output_file, int out_channels,
+                           const char *matrix_path) {
+    ChannelMatrix matrix;
+    if (matrix_path) {
+        if (channel_matrix_load(&matrix, matrix_path, input_info->channels) != 0) {
+            return -1;
+        }
+        if (matrix.out_channels != out_channels) {
+            fprintf(stderr, "Error: Matrix file %s has %d rows, the merged file has %d channels\n",
+                    matrix_path, matrix.out_channels, out_channels);
+            channel_matrix_free(&matrix);
+            return -1;
+        }
+    } else if (channel_matrix_init_default(&matrix, input_info->channels, out_channels) != 0) {
+        fprintf(stderr, "Error: No default %d -> %d channel matrix, use a matrix file\n", input_info->channels, out_channels);
+        return -1;
+    }
+
+    // Allocate buffers for reading chunks of data
+    const sf_count_t chunk_frames = 1024; // Arbitrary chunk size
+    float *buffer = (float *)malloc(chunk_frames * input_info->channels * sizeof(float));
+    float *remapped = (float *)malloc(chunk_frames * out_channels * sizeof(float));
+    if (!buffer || !remapped) {
+        fprintf(stderr, "Error: Could not allocate memory for buffer.\n");
+        free(buffer);
+        free(remapped);
+        channel_matrix_free(&matrix);
+        return -1;
+    }
+
+    // Read and write the file in chunks, skipping the default matrix when the layouts already match
+    const int pass_through = (!matrix_path && input_info->channels == out_channels);
+    sf_count_t read_frames;
+    int status = 0;
+    while ((read_frames = sf_readf_float(input_file, buffer, chunk_frames)) > 0) {
+        const float *frames = buffer;
+        if (!pass_through) {
+            channel_matrix_apply(&matrix, buffer, remapped, read_frames);
+            frames = remapped;
+        }
+        if (sf_writef_float(output_file, frames, read_frames) != read_frames) {
+            fprintf(stderr, "Error: Could not write all samples to the output file.\n");
+            status = -1;
+            break;
+        }
+    }
+
+    free(buffer);
+    free(remapped);
+    channel_matrix_free(&matrix);
+    return status;
 }
 
 // Function to merge audio file
-void merge_wav_files(const char *input1_path, const char *input2_path, const char *output_path) {
+int merge_wav_files(const char *input1_path, const char *input2_path, const char *output_path) {
+    return merge_wav_files_to_channels(input1_path, input2_path, output_path, 0);
+}
+
+// Function to merge audio files into a given channel count (0 keeps the layout of the first file)
+int merge_wav_files_to_channels(const char *input1_path, const char *input2_path, const char *output_path, int out_channels) {
+    return merge_wav_files_remapped(input1_path, input2_path, output_path, out_channels, NULL);
+}
+
+// Function to merge audio files, remapping the second one through a matrix file if given
+int merge_wav_files_remapped(const char *input1_path, const char *input2_path, const char *output_path, int out_channels,
+                             const char *matrix_path) {
     // File handles and info structures
     SNDFILE *input_file = NULL, *output_file = NULL;
     SF_INFO input_info = {0}, output_info = {0};
-
-    // Buffers
-    float *buffer = NULL;
+    OutputFile output;
 
     // Open the first input file
     input_file = sf_open(input1_path, SFM_READ, &input_info);
     if (!input_file) {
         fprintf(stderr, "Error: Could not open first input file %s\n", input1_path);
-        return;
+        return -1;
     }
 
-    // Set up the output file's info (same as the first input file)
+    // Set up the output file's info (same as the first input file, except for the channel layout)
     output_info = input_info;
+    if (out_channels > 0) {
+        output_info.channels = out_channels;
+    }
 
     // Open the output file
-    output_file = sf_open(output_path, SFM_WRITE, &output_info);
+    output_file = open_output_file(&output, output_path, &output_info);
     if (!output_file) {
         fprintf(stderr, "Error: Could not open output file: %s\n", output_path);
         sf_close(input_file);
-        return;
-    }
-
-    // Allocate a buffer for reading chunks of data
-    sf_count_t buffer_size = 1024 * input_info.channels; // Arbitrary chunk size
-    buffer = (float *)malloc(buffer_size * sizeof(float));
-    if (!buffer) {
-        fprintf(stderr, "Error: Could not allocate memory for buffer.\n");
-        sf_close(input_file);
-        sf_close(output_file);
-        return;
+        return -1;
     }
 
     // Read and write the first file in chunks
-    sf_count_t read_count;
-    while ((read_count = sf_read_float(input_file, buffer, buffer_size)) > 0) {
-        sf_write_float(output_file, buffer, read_count);
+    if (append_remapped(input_file, &input_info, output_file, output_info.channels, NULL) != 0) {
+        sf_close(input_file);
+        close_output_file(&output, -1);
+        return -1;
     }
 
     sf_close(input_file); // Close the first input file
@@ -295,16 +526,13 @@ void merge_wav_files(const char *input1_path, const char *input2_path, const cha
     input_file = sf_open(input2_path, SFM_READ, &input_info);
     if (!input_file) {
         fprintf(stderr, "Error: Could not open second input file: %s\n", input2_path);
-        free(buffer);
-        sf_close(output_file);
-        return;
+        close_output_file(&output, -1);
+        return -1;
     }
 
-    // Ensure the second file matches the format of the first
-    // Ensure the second file matches the format of the first
+    // Ensure the second file matches the format of the first (channel counts are remapped)
     if (input_info.format != output_info.format ||
-        input_info.samplerate != output_info.samplerate ||
-        input_info.channels != output_info.channels) {
+        input_info.samplerate != output_info.samplerate) {
         fprintf(stderr, "Error: Input files are not compatible for merging due to:\n");
         if (input_info.format != output_info.format) {
             fprintf(stderr, "- Different audio formats: %d vs %d\n", output_info.format, input_info.format);
@@ -312,30 +540,24 @@ void merge_wav_files(const char *input1_path, const char *input2_path, const cha
         if (input_info.samplerate != output_info.samplerate) {
             fprintf(stderr, "- Different sample rates: %d Hz vs %d Hz\n", output_info.samplerate, input_info.samplerate);
         }
-        if (input_info.channels != output_info.channels) {
-            fprintf(stderr, "- Different channel counts: %d vs %d\n", output_info.channels, input_info.channels);
-        }
 
         sf_close(input_file);
-        free(buffer);
-        sf_close(output_file);
-        if (unlink(output_path) != 0) {
-            fprintf(stderr, "Error: Failed to delete output file %s", output_path);
-        }
-        return;
+        close_output_file(&output, -1);
+        return -1;
         }
 
     // Read and write the second file in chunks
-    while ((read_count = sf_read_float(input_file, buffer, buffer_size)) > 0) {
-        sf_write_float(output_file, buffer, read_count);
-    }
+    const int status = append_remapped(input_file, &input_info, output_file, output_info.channels, matrix_path);
 
     // Clean up
-    free(buffer);
     sf_close(input_file);
-    sf_close(output_file);
+    if (close_output_file(&output, status) != 0) {
+        return -1;
+    }
 
     printf("Successfully merged %s and %s into %s.\n", input1_path, input2_path, output_path);
+
+    return 0;
 }
 
 
@@ -366,12 +588,37 @@ void print_help() {
     printf("    Add fade-out:\n");
     printf("        ./ggsound --fade-out <input name> fading-time (--name <output name>)\n");
     printf("    Merge 2 files:\n");
-    printf("        ./ggsound --merge <first file> <second file> (--name <output name>)\n");
+    printf("        ./ggsound --merge <first file> <second file> (--channels <count | matrix file>) (--name <output name>)\n");
+    printf("    Remap channels (e.g. mono to stereo, stereo to mono, 5.1 to stereo):\n");
+    printf("        ./ggsound --channels <input name> <count | matrix file> (--name <output name>)\n");
+    printf("    Measure peak, RMS, DC offset, clipping and EBU R128 loudness:\n");
+    printf("        ./ggsound --analyze <input name>\n");
+    printf("    Normalize to a loudness (e.g. -23 or -23LUFS) or peak (e.g. -1dBFS) target:\n");
+    printf("        ./ggsound --normalize <input name> <target> (--name <output name>)\n");
+    printf("    Build the min/max/RMS peak index sidecar (<input name>.ggpk):\n");
+    printf("        ./ggsound --index <input name>\n");
+    printf("    Print a min/max/RMS overview of <width> columns from the peak index (built on first use):\n");
+    printf("        ./ggsound --peaks <input name> ([start:end]) <width>\n");
+    printf("    Trim leading and trailing silence quieter than threshold-db and longer than min-ms:\n");
+    printf("        ./ggsound --trim-silence <input name> threshold-db min-ms (--name <output name>)\n");
+    printf("    List silent spans (usable as split points or --cut ranges):\n");
+    printf("        ./ggsound --detect-silence <input name> threshold-db min-ms\n");
+    printf("    Mix overlays onto a base track at offsets (seconds) with per-overlay gain (dB):\n");
+    printf("        ./ggsound --mix <base file> <overlay>@<offset>:<gain>dB ... (--envelope <envelope file>) (--soft-clip)\n");
+    printf("                  (--name <output name>)\n");
+    printf("    Apply breakpoint gain automation (one \"time gain-db [linear|exp|hold]\" per line):\n");
+    printf("        ./ggsound --envelope <input name> <envelope file> (--name <output name>)\n");
+    printf("    Reuse results of identical jobs (any command that writes a file, LRU-evicted above the size limit):\n");
+    printf("        ./ggsound <command> --cache-dir <directory> (--cache-max-mb <size>)\n");
+    printf("    Show cache hits, misses, evictions and size:\n");
+    printf("        ./ggsound --cache-stats --cache-dir <directory>\n");
     printf("    Learn file's duration:\n");
     printf("        ./ggsound <filename.wav>\n");
     printf("\n");
     printf("    Note 1: parameters in the round brackets are optional.\n");
     printf("    Note 2: all time values are written in seconds and can be entered in both int and float formats.\n");
+    printf("    Note 3: a matrix file has one line per output channel with one weight per input channel.\n");
+    printf("            In --merge it remaps the second file into the layout of the first.\n");
     printf("\n");
     printf("Have fun!\n");
 }
@@ -1,23 +1,57 @@
 #ifndef AUDIO_PROCESSING_H
 #define AUDIO_PROCESSING_H
 
+#include <sndfile.h>
+
 // Default directory for audio files
 #define AUDIO_DIR "../audio/"
 
 // Function to get the length of an audio file in seconds
 double get_audio_length(const char *filepath);
 
+// Output audio file written under a temporary name and moved over its destination once complete
+typedef struct {
+    SNDFILE *file;
+    char path[256];
+    char temp_path[512];
+} OutputFile;
+
+// Function to build a temporary path next to a destination, unique to this process
+void output_temp_path(const char *output_path, char *temp_path, size_t size);
+
+// Function to move a finished temporary file over its destination, returns 0 on success
+int replace_file(const char *temp_path, const char *output_path);
+
+// Function to create an output audio file under a temporary name next to its destination
+SNDFILE *open_output_file(OutputFile *output, const char *output_path, SF_INFO *info);
+
+// Function to close an output file, moving it over the destination when status is 0 and discarding it otherwise
+int close_output_file(OutputFile *output, int status);
+
+// Function to copy a file byte for byte
+int copy_file_raw(const char *input_path, const char *output_path);
+
 // Function to trim audio file
-void cut_wav_segment(const char *input_path, const char *output_path, double start_time, double end_time);
+int cut_wav_segment(const char *input_path, const char *output_path, double start_time, double end_time);
+
+// Function to copy frames [start_frame, end_frame) of a file into a new file
+int extract_wav_frames(const char *input_path, const char *output_path, sf_count_t start_frame, sf_count_t end_frame);
 
 // Function to add fade-in
-void add_fade_in(const char *input_path, const char *output_path, double fading_time);
+int add_fade_in(const char *input_path, const char *output_path, double fading_time);
 
 // Function to add fade-out
-void add_fade_out(const char *input_path, const char *output_path, double fading_time);
+int add_fade_out(const char *input_path, const char *output_path, double fading_time);
 
 // Function to merge audio file
-void merge_wav_files(const char *input1_path, const char *input2_path, const char *output_path);
+int merge_wav_files(const char *input1_path, const char *input2_path, const char *output_path);
+
+// Function to merge audio files into a given channel count (0 keeps the layout of the first file)
+int merge_wav_files_to_channels(const char *input1_path, const char *input2_path, const char *output_path, int out_channels);
+
+// Function to merge audio files, remapping the second one through a matrix file (rows = channels of the first file) if given
+int merge_wav_files_remapped(const char *input1_path, const char *input2_path, const char *output_path, int out_channels,
+                             const char *matrix_path);
 
 // Function to print help instructions
 void print_help();
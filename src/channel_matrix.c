@@ -0,0 +1,376 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sndfile.h>
+#include "channel_matrix.h"
+#include "audio_processing.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Weight of the centre and surround channels in the 5.1 -> stereo downmix (-3 dB)
+#define DOWNMIX_SIDE_GAIN 0.70710678f
+
+// Number of frames processed per read/write when remapping a file
+#define REMAP_CHUNK_FRAMES 1024
+
+// Function to build the default matrix for a channel count change
+int channel_matrix_init_default(ChannelMatrix *matrix, int in_channels, int out_channels) {
+    if (in_channels <= 0 || out_channels <= 0) {
+        return -1;
+    }
+
+    matrix->in_channels = in_channels;
+    matrix->out_channels = out_channels;
+    matrix->coeffs = (float *)calloc((size_t)in_channels * out_channels, sizeof(float));
+    if (!matrix->coeffs) {
+        return -1;
+    }
+
+    float *coeffs = matrix->coeffs;
+
+    if (in_channels == 6 && (out_channels == 2 || out_channels == 1)) {
+        // ITU-R BS.775 downmix of L R C LFE Ls Rs, LFE dropped, rows scaled so a full-scale input cannot clip;
+        // mono is the average of the two stereo rows
+        const float norm = 1.0f / (1.0f + 2.0f * DOWNMIX_SIDE_GAIN);
+        const float share = (out_channels == 1) ? 0.5f : 1.0f;
+        float *left = coeffs;
+        float *right = (out_channels == 2) ? coeffs + 6 : coeffs;
+        left[0] += norm * share;
+        left[2] += DOWNMIX_SIDE_GAIN * norm * share;
+        left[4] += DOWNMIX_SIDE_GAIN * norm * share;
+        right[1] += norm * share;
+        right[2] += DOWNMIX_SIDE_GAIN * norm * share;
+        right[5] += DOWNMIX_SIDE_GAIN * norm * share;
+        return 0;
+    }
+
+    if (in_channels == 1 && out_channels == 6) {
+        // Mono belongs in the centre channel, the rest of the 5.1 layout stays silent
+        coeffs[2] = 1.0f;
+        return 0;
+    }
+
+    if (in_channels == 1 || out_channels == 1) {
+        // Mono is duplicated to every output, or every input is averaged into mono
+        for (size_t i = 0; i < (size_t)in_channels * out_channels; ++i) {
+            coeffs[i] = (out_channels == 1) ? 1.0f / (float)in_channels : 1.0f;
+        }
+        return 0;
+    }
+
+    if (in_channels <= out_channels) {
+        // Same or wider layout (e.g. stereo -> 5.1): channels keep their place, the extra outputs stay silent
+        for (int ch = 0; ch < in_channels; ++ch) {
+            coeffs[(size_t)ch * in_channels + ch] = 1.0f;
+        }
+        return 0;
+    }
+
+    if (in_channels == 6) {
+        // No sensible default placement of the 5.1 channels (LFE included) in this layout
+        channel_matrix_free(matrix);
+        return -1;
+    }
+
+    // Narrower layout (e.g. quad -> stereo): fold input k into output k % out_channels and average every row
+    for (int out = 0; out < out_channels; ++out) {
+        float *row = coeffs + (size_t)out * in_channels;
+        int contributions = 0;
+        for (int in = out; in < in_channels; in += out_channels) {
+            row[in] = 1.0f;
+            contributions++;
+        }
+        for (int in = out; in < in_channels; in += out_channels) {
+            row[in] /= (float)contributions;
+        }
+    }
+
+    return 0;
+}
+
+// Function to load a matrix from a text file
+int channel_matrix_load(ChannelMatrix *matrix, const char *matrix_path, int in_channels) {
+    FILE *file = fopen(matrix_path, "r");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open matrix file %s\n", matrix_path);
+        return -1;
+    }
+
+    matrix->in_channels = in_channels;
+    matrix->out_channels = 0;
+    matrix->coeffs = NULL;
+
+    char line[4096];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+
+        // Skip comments and empty lines
+        char *cursor = line;
+        while (*cursor == ' ' || *cursor == '\t') cursor++;
+        if (*cursor == '#' || *cursor == '\n' || *cursor == '\r' || *cursor == '\0') {
+            continue;
+        }
+
+        float *coeffs = (float *)realloc(matrix->coeffs, (size_t)(matrix->out_channels + 1) * in_channels * sizeof(float));
+        if (!coeffs) {
+            fprintf(stderr, "Error: Could not allocate memory for channel matrix.\n");
+            channel_matrix_free(matrix);
+            fclose(file);
+            return -1;
+        }
+        matrix->coeffs = coeffs;
+
+        float *row = matrix->coeffs + (size_t)matrix->out_channels * in_channels;
+        int count = 0;
+        char *endptr;
+        for (;;) {
+            float value = strtof(cursor, &endptr);
+            if (endptr == cursor) {
+                break;
+            }
+            if (count < in_channels) {
+                row[count] = value;
+            }
+            count++;
+            cursor = endptr;
+        }
+
+        while (*cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r') cursor++;
+        if (*cursor != '\0' || count != in_channels) {
+            fprintf(stderr, "Error: Matrix file %s line %d must contain %d numeric weights.\n", matrix_path, line_number, in_channels);
+            channel_matrix_free(matrix);
+            fclose(file);
+            return -1;
+        }
+
+        matrix->out_channels++;
+    }
+
+    fclose(file);
+
+    if (matrix->out_channels == 0) {
+        fprintf(stderr, "Error: Matrix file %s has no rows.\n", matrix_path);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Function to release the matrix coefficients
+void channel_matrix_free(ChannelMatrix *matrix) {
+    free(matrix->coeffs);
+    matrix->coeffs = NULL;
+    matrix->out_channels = 0;
+}
+
+// Generic path: one dot product per output sample
+static void remap_generic(const ChannelMatrix *matrix, const float *input, float *output, sf_count_t frames) {
+    const int in_channels = matrix->in_channels;
+    const int out_channels = matrix->out_channels;
+
+    for (sf_count_t i = 0; i < frames; ++i) {
+        const float *frame = input + i * in_channels;
+        for (int out = 0; out < out_channels; ++out) {
+            const float *row = matrix->coeffs + (size_t)out * in_channels;
+            float acc = 0.0f;
+            for (int in = 0; in < in_channels; ++in) {
+                acc += row[in] * frame[in];
+            }
+            output[i * out_channels + out] = acc;
+        }
+    }
+}
+
+// Mono -> stereo
+static sf_count_t remap_1_to_2(const float *coeffs, const float *input, float *output, sf_count_t frames) {
+    sf_count_t i = 0;
+#if defined(__SSE2__)
+    const __m128 gain_left = _mm_set1_ps(coeffs[0]);
+    const __m128 gain_right = _mm_set1_ps(coeffs[1]);
+    for (; i + 4 <= frames; i += 4) {
+        __m128 mono = _mm_loadu_ps(input + i);
+        __m128 left = _mm_mul_ps(mono, gain_left);
+        __m128 right = _mm_mul_ps(mono, gain_right);
+        _mm_storeu_ps(output + 2 * i, _mm_unpacklo_ps(left, right));
+        _mm_storeu_ps(output + 2 * i + 4, _mm_unpackhi_ps(left, right));
+    }
+#else
+    (void)coeffs;
+    (void)input;
+    (void)output;
+    (void)frames;
+#endif
+    return i;
+}
+
+// Stereo -> mono
+static sf_count_t remap_2_to_1(const float *coeffs, const float *input, float *output, sf_count_t frames) {
+    sf_count_t i = 0;
+#if defined(__SSE2__)
+    const __m128 gain_left = _mm_set1_ps(coeffs[0]);
+    const __m128 gain_right = _mm_set1_ps(coeffs[1]);
+    for (; i + 4 <= frames; i += 4) {
+        __m128 first = _mm_loadu_ps(input + 2 * i);
+        __m128 second = _mm_loadu_ps(input + 2 * i + 4);
+        __m128 left = _mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 right = _mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(output + i, _mm_add_ps(_mm_mul_ps(left, gain_left), _mm_mul_ps(right, gain_right)));
+    }
+#else
+    (void)coeffs;
+    (void)input;
+    (void)output;
+    (void)frames;
+#endif
+    return i;
+}
+
+// 5.1 -> stereo
+static sf_count_t remap_6_to_2(const float *coeffs, const float *input, float *output, sf_count_t frames) {
+    sf_count_t i = 0;
+#if defined(__SSE2__)
+    __m128 gain_left[6];
+    __m128 gain_right[6];
+    for (int ch = 0; ch < 6; ++ch) {
+        gain_left[ch] = _mm_set1_ps(coeffs[ch]);
+        gain_right[ch] = _mm_set1_ps(coeffs[6 + ch]);
+    }
+
+    for (; i + 4 <= frames; i += 4) {
+        // 4 frames are 24 contiguous floats: 6 full loads
+        const float *block = input + 6 * i;
+        const __m128 r0 = _mm_loadu_ps(block);      // f0c0 f0c1 f0c2 f0c3
+        const __m128 r1 = _mm_loadu_ps(block + 4);  // f0c4 f0c5 f1c0 f1c1
+        const __m128 r2 = _mm_loadu_ps(block + 8);  // f1c2 f1c3 f1c4 f1c5
+        const __m128 r3 = _mm_loadu_ps(block + 12); // f2c0 f2c1 f2c2 f2c3
+        const __m128 r4 = _mm_loadu_ps(block + 16); // f2c4 f2c5 f3c0 f3c1
+        const __m128 r5 = _mm_loadu_ps(block + 20); // f3c2 f3c3 f3c4 f3c5
+
+        // Gather channel pairs of two frames, e.g. pair01_a = f0c0 f0c1 f1c0 f1c1
+        const __m128 pair01_a = _mm_shuffle_ps(r0, r1, _MM_SHUFFLE(3, 2, 1, 0));
+        const __m128 pair23_a = _mm_shuffle_ps(r0, r2, _MM_SHUFFLE(1, 0, 3, 2));
+        const __m128 pair45_a = _mm_shuffle_ps(r1, r2, _MM_SHUFFLE(3, 2, 1, 0));
+        const __m128 pair01_b = _mm_shuffle_ps(r3, r4, _MM_SHUFFLE(3, 2, 1, 0));
+        const __m128 pair23_b = _mm_shuffle_ps(r3, r5, _MM_SHUFFLE(1, 0, 3, 2));
+        const __m128 pair45_b = _mm_shuffle_ps(r4, r5, _MM_SHUFFLE(3, 2, 1, 0));
+
+        // Split the pairs into one vector per channel holding the 4 frames
+        __m128 lanes[6];
+        lanes[0] = _mm_shuffle_ps(pair01_a, pair01_b, _MM_SHUFFLE(2, 0, 2, 0));
+        lanes[1] = _mm_shuffle_ps(pair01_a, pair01_b, _MM_SHUFFLE(3, 1, 3, 1));
+        lanes[2] = _mm_shuffle_ps(pair23_a, pair23_b, _MM_SHUFFLE(2, 0, 2, 0));
+        lanes[3] = _mm_shuffle_ps(pair23_a, pair23_b, _MM_SHUFFLE(3, 1, 3, 1));
+        lanes[4] = _mm_shuffle_ps(pair45_a, pair45_b, _MM_SHUFFLE(2, 0, 2, 0));
+        lanes[5] = _mm_shuffle_ps(pair45_a, pair45_b, _MM_SHUFFLE(3, 1, 3, 1));
+
+        __m128 left = _mm_mul_ps(lanes[0], gain_left[0]);
+        __m128 right = _mm_mul_ps(lanes[0], gain_right[0]);
+        for (int ch = 1; ch < 6; ++ch) {
+            left = _mm_add_ps(left, _mm_mul_ps(lanes[ch], gain_left[ch]));
+            right = _mm_add_ps(right, _mm_mul_ps(lanes[ch], gain_right[ch]));
+        }
+        _mm_storeu_ps(output + 2 * i, _mm_unpacklo_ps(left, right));
+        _mm_storeu_ps(output + 2 * i + 4, _mm_unpackhi_ps(left, right));
+    }
+#else
+    (void)coeffs;
+    (void)input;
+    (void)output;
+    (void)frames;
+#endif
+    return i;
+}
+
+// Function to remap interleaved frames from the matrix input layout to its output layout
+void channel_matrix_apply(const ChannelMatrix *matrix, const float *input, float *output, sf_count_t frames) {
+    sf_count_t done = 0;
+
+    // Specialized kernels handle whole vectors, the generic path finishes the tail
+    if (matrix->in_channels == 1 && matrix->out_channels == 2) {
+        done = remap_1_to_2(matrix->coeffs, input, output, frames);
+    } else if (matrix->in_channels == 2 && matrix->out_channels == 1) {
+        done = remap_2_to_1(matrix->coeffs, input, output, frames);
+    } else if (matrix->in_channels == 6 && matrix->out_channels == 2) {
+        done = remap_6_to_2(matrix->coeffs, input, output, frames);
+    }
+
+    if (done < frames) {
+        remap_generic(matrix, input + done * matrix->in_channels, output + done * matrix->out_channels, frames - done);
+    }
+}
+
+// Function to remap the channels of an audio file into a new file
+int remap_channels(const char *input_path, const char *output_path, int out_channels, const char *matrix_path) {
+    SF_INFO input_info = {0};
+
+    SNDFILE *input_file = sf_open(input_path, SFM_READ, &input_info);
+    if (!input_file) {
+        fprintf(stderr, "Error: Could not open input file %s\n", input_path);
+        return -1;
+    }
+
+    // Build the matrix either from the file or from the requested channel count
+    ChannelMatrix matrix;
+    int status = matrix_path ? channel_matrix_load(&matrix, matrix_path, input_info.channels)
+                             : channel_matrix_init_default(&matrix, input_info.channels, out_channels);
+    if (status != 0) {
+        if (!matrix_path) {
+            fprintf(stderr, "Error: No default %d -> %d channel matrix for %s, use a matrix file\n", input_info.channels, out_channels, input_path);
+        }
+        sf_close(input_file);
+        return -1;
+    }
+
+    SF_INFO output_info = input_info;
+    output_info.channels = matrix.out_channels;
+
+    OutputFile output;
+    SNDFILE *output_file = open_output_file(&output, output_path, &output_info);
+    if (!output_file) {
+        fprintf(stderr, "Error: Could not open output file %s\n", output_path);
+        channel_matrix_free(&matrix);
+        sf_close(input_file);
+        return -1;
+    }
+
+    float *in_buffer = (float *)malloc((size_t)REMAP_CHUNK_FRAMES * matrix.in_channels * sizeof(float));
+    float *out_buffer = (float *)malloc((size_t)REMAP_CHUNK_FRAMES * matrix.out_channels * sizeof(float));
+    if (!in_buffer || !out_buffer) {
+        fprintf(stderr, "Error: Could not allocate memory for buffer.\n");
+        free(in_buffer);
+        free(out_buffer);
+        channel_matrix_free(&matrix);
+        sf_close(input_file);
+        close_output_file(&output, -1);
+        return -1;
+    }
+
+    // Stream the file through the matrix chunk by chunk
+    sf_count_t read_frames;
+    status = 0;
+    while ((read_frames = sf_readf_float(input_file, in_buffer, REMAP_CHUNK_FRAMES)) > 0) {
+        channel_matrix_apply(&matrix, in_buffer, out_buffer, read_frames);
+        if (sf_writef_float(output_file, out_buffer, read_frames) != read_frames) {
+            fprintf(stderr, "Error: Could not write all samples to the output file.\n");
+            status = -1;
+            break;
+        }
+    }
+
+    // Clean up
+    free(in_buffer);
+    free(out_buffer);
+    sf_close(input_file);
+    if (close_output_file(&output, status) != 0) {
+        channel_matrix_free(&matrix);
+        return -1;
+    }
+
+    printf("Channels of %s remapped from %d to %d and saved to %s\n", input_path, matrix.in_channels, matrix.out_channels, output_path);
+    channel_matrix_free(&matrix);
+
+    return 0;
+}
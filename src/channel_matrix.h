@@ -0,0 +1,33 @@
+#ifndef CHANNEL_MATRIX_H
+#define CHANNEL_MATRIX_H
+
+#include <sndfile.h>
+
+// Mixing matrix that maps in_channels input channels onto out_channels output channels.
+// coeffs is stored row-major: coeffs[out * in_channels + in] is the weight of input channel
+// "in" in output channel "out".
+typedef struct {
+    int in_channels;
+    int out_channels;
+    float *coeffs;
+} ChannelMatrix;
+
+// Function to build the default matrix for a channel count change: 1->N duplicates (1->6 feeds the centre),
+// N->1 averages, 6->2 and 6->1 use the ITU 5.1 downmix without LFE, wider layouts keep channels in place and
+// leave the extra outputs silent, narrower ones fold channel k into k % out_channels; other 5.1 downmixes
+// have no default and return -1 (use a matrix file)
+int channel_matrix_init_default(ChannelMatrix *matrix, int in_channels, int out_channels);
+
+// Function to load a matrix from a text file (one output channel per line, one weight per input channel)
+int channel_matrix_load(ChannelMatrix *matrix, const char *matrix_path, int in_channels);
+
+// Function to release the matrix coefficients
+void channel_matrix_free(ChannelMatrix *matrix);
+
+// Function to remap interleaved frames from the matrix input layout to its output layout
+void channel_matrix_apply(const ChannelMatrix *matrix, const float *input, float *output, sf_count_t frames);
+
+// Function to remap the channels of an audio file (out_channels or matrix file) into a new file
+int remap_channels(const char *input_path, const char *output_path, int out_channels, const char *matrix_path);
+
+#endif // CHANNEL_MATRIX_H
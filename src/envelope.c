@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <sndfile.h>
+#include "envelope.h"
+#include "audio_block.h"
+#include "audio_processing.h"
+
+// One stretch of constant curve between two breakpoints (or before the first / after the last)
+typedef struct {
+    sf_count_t start;
+    sf_count_t end;
+    double start_db;
+    double end_db;
+    EnvelopeCurve curve;
+} EnvelopePiece;
+
+// Function to load an envelope file
+int envelope_load(GainEnvelope *envelope, const char *envelope_path) {
+    FILE *file = fopen(envelope_path, "r");
+    if (!file) {
+        fprintf(stderr, "Error: Could not open envelope file %s\n", envelope_path);
+        return -1;
+    }
+
+    envelope->count = 0;
+    envelope->points = NULL;
+
+    char line[256];
+    int line_number = 0;
+    int capacity = 0;
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+
+        // Skip comments and empty lines
+        char *cursor = line;
+        while (*cursor == ' ' || *cursor == '\t') cursor++;
+        if (*cursor == '#' || *cursor == '\n' || *cursor == '\r' || *cursor == '\0') {
+            continue;
+        }
+
+        EnvelopePoint point;
+        char curve[32] = "linear";
+        int fields = sscanf(cursor, "%lf %lf %31s", &point.time, &point.gain_db, curve);
+        if (fields < 2 || !isfinite(point.time) || !isfinite(point.gain_db) || point.time < 0 ||
+            point.time > ENVELOPE_MAX_SECONDS ||
+            (envelope->count > 0 && point.time < envelope->points[envelope->count - 1].time)) {
+            fprintf(stderr, "Error: Envelope file %s line %d must be \"time gain-db [curve]\" with increasing times\n",
+                    envelope_path, line_number);
+            envelope_free(envelope);
+            fclose(file);
+            return -1;
+        }
+
+        if (strcmp(curve, "linear") == 0 || strcmp(curve, "lin") == 0) {
+            point.curve = CURVE_LINEAR;
+        } else if (strcmp(curve, "exp") == 0 || strcmp(curve, "db") == 0) {
+            point.curve = CURVE_EXPONENTIAL;
+        } else if (strcmp(curve, "hold") == 0 || strcmp(curve, "step") == 0) {
+            point.curve = CURVE_HOLD;
+        } else {
+            fprintf(stderr, "Error: Envelope file %s line %d has unknown curve \"%s\" (use linear, exp or hold)\n",
+                    envelope_path, line_number, curve);
+            envelope_free(envelope);
+            fclose(file);
+            return -1;
+        }
+
+        if (envelope->count == capacity) {
+            capacity = capacity ? capacity * 2 : 16;
+            EnvelopePoint *points = (EnvelopePoint *)realloc(envelope->points, capacity * sizeof(EnvelopePoint));
+            if (!points) {
+                fprintf(stderr, "Error: Could not allocate memory for envelope.\n");
+                envelope_free(envelope);
+                fclose(file);
+                return -1;
+            }
+            envelope->points = points;
+        }
+        envelope->points[envelope->count++] = point;
+    }
+
+    fclose(file);
+
+    if (envelope->count == 0) {
+        fprintf(stderr, "Error: Envelope file %s has no breakpoints.\n", envelope_path);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Function to release the breakpoints of an envelope
+void envelope_free(GainEnvelope *envelope) {
+    free(envelope->points);
+    envelope->points = NULL;
+    envelope->count = 0;
+}
+
+// Function to get the frame of a breakpoint
+static sf_count_t point_frame(const EnvelopePoint *point, int samplerate) {
+    return (sf_count_t)(point->time * samplerate + 0.5);
+}
+
+// Function to describe piece k: -1 is the flat lead-in, count - 1 the flat tail, others join points k and k + 1
+static EnvelopePiece envelope_piece(const GainEnvelope *envelope, int samplerate, int k) {
+    EnvelopePiece piece;
+    const EnvelopePoint *points = envelope->points;
+    const int last = envelope->count - 1;
+
+    if (k < 0) {
+        piece.start = 0;
+        piece.end = point_frame(&points[0], samplerate);
+        piece.start_db = piece.end_db = points[0].gain_db;
+        piece.curve = CURVE_HOLD;
+    } else if (k >= last) {
+        piece.start = point_frame(&points[last], samplerate);
+        piece.end = INT64_MAX;
+        piece.start_db = piece.end_db = points[last].gain_db;
+        piece.curve = CURVE_HOLD;
+    } else {
+        piece.start = point_frame(&points[k], samplerate);
+        piece.end = point_frame(&points[k + 1], samplerate);
+        piece.start_db = points[k].gain_db;
+        piece.end_db = (points[k].curve == CURVE_HOLD) ? points[k].gain_db : points[k + 1].gain_db;
+        piece.curve = points[k].curve;
+    }
+
+    return piece;
+}
+
+// Function to check whether a piece leaves the samples untouched
+static int piece_is_unity(const EnvelopePiece *piece) {
+    return piece->start_db == 0.0 && piece->end_db == 0.0;
+}
+
+// Function to find the first piece that ends after frame, by binary search over the sorted breakpoints
+static int envelope_first_piece(const GainEnvelope *envelope, int samplerate, sf_count_t frame) {
+    int low = 0;
+    int high = envelope->count;
+    while (low < high) {
+        const int middle = low + (high - low) / 2;
+        if (point_frame(&envelope->points[middle], samplerate) > frame) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    return low - 1;
+}
+
+// Function to check whether frames [start_frame, end_frame) are left untouched
+int envelope_is_unity(const GainEnvelope *envelope, int samplerate, sf_count_t start_frame, sf_count_t end_frame) {
+    for (int k = envelope_first_piece(envelope, samplerate, start_frame); k < envelope->count; ++k) {
+        EnvelopePiece piece = envelope_piece(envelope, samplerate, k);
+        if (piece.start >= end_frame) {
+            break;
+        }
+        if (piece.end > start_frame && !piece_is_unity(&piece)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Function to apply the envelope to a block whose first frame sits at position in the file
+void envelope_apply_block(const GainEnvelope *envelope, int samplerate, AudioBlock *block, sf_count_t position) {
+    const sf_count_t block_end = position + block->frames;
+
+    // Only the pieces overlapping the block are visited, so long envelopes cost O(log breakpoints) per block
+    for (int k = envelope_first_piece(envelope, samplerate, position); k < envelope->count; ++k) {
+        EnvelopePiece piece = envelope_piece(envelope, samplerate, k);
+        if (piece.start >= block_end) {
+            break;
+        }
+        if (piece.end <= position || piece.end <= piece.start) {
+            continue;
+        }
+
+        // Regions at exactly 0 dB pass through without being touched
+        if (piece_is_unity(&piece)) {
+            continue;
+        }
+
+        const sf_count_t from = (piece.start > position) ? piece.start : position;
+        const sf_count_t to = (piece.end < block_end) ? piece.end : block_end;
+        const double length = (double)(piece.end - piece.start);
+        const double progress = (double)(from - piece.start) / length;
+
+        if (piece.curve == CURVE_HOLD || piece.start_db == piece.end_db) {
+            const float gain = (float)pow(10.0, piece.start_db / 20.0);
+            audio_block_apply_ramp(block, from - position, to - from, gain, 0.0f);
+        } else if (piece.curve == CURVE_LINEAR) {
+            const double start_gain = pow(10.0, piece.start_db / 20.0);
+            const double end_gain = pow(10.0, piece.end_db / 20.0);
+            const double step = (end_gain - start_gain) / length;
+            audio_block_apply_ramp(block, from - position, to - from, (float)(start_gain + step * (from - piece.start)), (float)step);
+        } else {
+            // A ramp starting from a gain that underflows a float would stay silent, so mute is raised to the floor
+            const double piece_start_db = fmax(piece.start_db, ENVELOPE_FLOOR_DB);
+            const double piece_end_db = fmax(piece.end_db, ENVELOPE_FLOOR_DB);
+            const double start_db = piece_start_db + (piece_end_db - piece_start_db) * progress;
+            const double ratio = pow(10.0, (piece_end_db - piece_start_db) / length / 20.0);
+            audio_block_apply_exp_ramp(block, from - position, to - from, (float)pow(10.0, start_db / 20.0), (float)ratio);
+        }
+    }
+}
+
+// Function to apply an envelope file to an audio file in one streaming pass
+int apply_envelope(const char *input_path, const char *output_path, const char *envelope_path) {
+    SF_INFO sfinfo = {0};
+
+    GainEnvelope envelope;
+    if (envelope_load(&envelope, envelope_path) != 0) {
+        return -1;
+    }
+
+    SNDFILE *input_file = sf_open(input_path, SFM_READ, &sfinfo);
+    if (!input_file) {
+        fprintf(stderr, "Error: Could not open input file %s\n", input_path);
+        envelope_free(&envelope);
+        return -1;
+    }
+
+    AudioBlock block;
+    if (audio_block_init(&block, sfinfo.channels, AUDIO_BLOCK_FRAMES) != 0) {
+        fprintf(stderr, "Error: Could not allocate memory for audio data.\n");
+        envelope_free(&envelope);
+        sf_close(input_file);
+        return -1;
+    }
+
+    OutputFile output;
+    SNDFILE *output_file = open_output_file(&output, output_path, &sfinfo);
+    if (!output_file) {
+        fprintf(stderr, "Error: Could not open output file %s\n", output_path);
+        audio_block_free(&block);
+        envelope_free(&envelope);
+        sf_close(input_file);
+        return -1;
+    }
+    sf_command(output_file, SFC_SET_CLIPPING, NULL, SF_TRUE);
+
+    // Untouched chunks go straight from the read buffer to the output, the rest through the planar stage
+    sf_count_t position = 0;
+    sf_count_t read_frames;
+    int status = 0;
+    while ((read_frames = sf_readf_float(input_file, block.interleaved, block.capacity)) > 0) {
+        if (envelope_is_unity(&envelope, sfinfo.samplerate, position, position + read_frames)) {
+            if (sf_writef_float(output_file, block.interleaved, read_frames) != read_frames) {
+                fprintf(stderr, "Error: Could not write all samples to the output file.\n");
+                status = -1;
+                break;
+            }
+        } else {
+            audio_block_deinterleave(&block, block.interleaved, read_frames);
+            envelope_apply_block(&envelope, sfinfo.samplerate, &block, position);
+            if (audio_block_write(&block, output_file) != read_frames) {
+                fprintf(stderr, "Error: Could not write all samples to the output file.\n");
+                status = -1;
+                break;
+            }
+        }
+        position += read_frames;
+    }
+
+    // Clean up
+    audio_block_free(&block);
+    sf_close(input_file);
+    if (close_output_file(&output, status) != 0) {
+        envelope_free(&envelope);
+        return -1;
+    }
+
+    printf("Envelope with %d breakpoints from %s applied to %s and saved to %s\n", envelope.count, envelope_path, input_path, output_path);
+    envelope_free(&envelope);
+
+    return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef ENVELOPE_H
+#define ENVELOPE_H
+
+#include <sndfile.h>
+#include "audio_block.h"
+
+// Shape of the gain between a breakpoint and the next one
+typedef enum {
+    CURVE_LINEAR,      // Linear in amplitude
+    CURVE_EXPONENTIAL, // Linear in dB
+    CURVE_HOLD         // Keeps the breakpoint gain until the next breakpoint
+} EnvelopeCurve;
+
+// Latest breakpoint time in seconds: times any int sample rate stays well inside the sf_count_t range
+#define ENVELOPE_MAX_SECONDS 1e9
+
+// Lowest gain an exponential curve ramps from or to, quieter breakpoints are raised to it on those curves
+#define ENVELOPE_FLOOR_DB -144.0
+
+// One breakpoint of a gain envelope
+typedef struct {
+    double time;    // Seconds from the start of the file
+    double gain_db; // Gain at this breakpoint
+    EnvelopeCurve curve;
+} EnvelopePoint;
+
+// Breakpoint gain automation, flat before the first and after the last breakpoint
+typedef struct {
+    int count;
+    EnvelopePoint *points;
+} GainEnvelope;
+
+// Function to load an envelope file ("time gain-db [linear|exp|hold]" per line), returns 0 on success
+int envelope_load(GainEnvelope *envelope, const char *envelope_path);
+
+// Function to release the breakpoints of an envelope
+void envelope_free(GainEnvelope *envelope);
+
+// Function to check whether frames [start_frame, end_frame) are left untouched (0 dB throughout)
+int envelope_is_unity(const GainEnvelope *envelope, int samplerate, sf_count_t start_frame, sf_count_t end_frame);
+
+// Function to apply the envelope to a block whose first frame sits at position in the file
+void envelope_apply_block(const GainEnvelope *envelope, int samplerate, AudioBlock *block, sf_count_t position);
+
+// Function to apply an envelope file to an audio file in one streaming pass
+int apply_envelope(const char *input_path, const char *output_path, const char *envelope_path);
+
+#endif // ENVELOPE_H
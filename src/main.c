@@ -1,10 +1,52 @@
 #include <stdio.h>
 #include <string.h>
 #include "audio_processing.h"
+#include "channel_matrix.h"
+#include "analysis.h"
+#include "peak_index.h"
+#include "silence.h"
+#include "mix.h"
+#include "envelope.h"
+#include "result_cache.h"
 #include <stdlib.h>
 
 #ifndef TEST_BUILD
-int main(int argc, char *argv[]) {
+// Function to parse "[start:end]", "[:end]" or "[start:]" (end is -1.0 when open), returns 0 on success
+static int parse_time_range(const char *arg, double *start_time, double *end_time) {
+    size_t length = strlen(arg);
+    if (length < 3 || arg[0] != '[' || arg[length - 1] != ']') {
+        return 1;
+    }
+
+    char *endptr;
+    const char *cursor = arg + 1;
+    *start_time = 0.0;
+    *end_time = -1.0;
+
+    if (*cursor != ':') {
+        *start_time = strtod(cursor, &endptr);
+        if (endptr == cursor || *endptr != ':') {
+            return 1;
+        }
+        cursor = endptr;
+    }
+    cursor++;
+
+    if (*cursor != ']') {
+        *end_time = strtod(cursor, &endptr);
+        if (endptr == cursor || *endptr != ']' || *end_time < 0) {
+            return 1;
+        }
+    }
+
+    if (*start_time < 0 || (*end_time >= 0 && *end_time <= *start_time)) {
+        return 1;
+    }
+    return 0;
+}
+
+// Function to run a single command
+static int run_command(int argc, char *argv[]) {
     if (argc < 2) {
         printf("No arguments given\n");
         printf("Try \"./ggsound --help\"\n");
@@ -93,8 +135,7 @@ int main(int argc, char *argv[]) {
             snprintf(output_path, sizeof(output_path), "%s%s", AUDIO_DIR, "gogi.wav");
         }
 
-        cut_wav_segment(input_path, output_path, start_time, end_time);
-        return 0;
+        return (cut_wav_segment(input_path, output_path, start_time, end_time) == 0) ? 0 : 1;
     }
 
     if (strcmp(argv[1], "--fade-in") == 0) {
@@ -131,8 +172,7 @@ int main(int argc, char *argv[]) {
             snprintf(output_path, sizeof(output_path), "%s%s", AUDIO_DIR, "gogi.wav");
         }
 
-        add_fade_in(input_path, output_path, fading_time);
-        return 0;
+        return (add_fade_in(input_path, output_path, fading_time) == 0) ? 0 : 1;
     }
 
     if (strcmp(argv[1], "--fade-out") == 0) {
@@ -169,40 +209,310 @@ int main(int argc, char *argv[]) {
             snprintf(output_path, sizeof(output_path), "%s%s", AUDIO_DIR, "gogi.wav");
         }
 
-        add_fade_out(input_path, output_path, fading_time);
-        return 0;
+        return (add_fade_out(input_path, output_path, fading_time) == 0) ? 0 : 1;
     }
 
     if (strcmp(argv[1], "--merge") == 0) {
-        if (argc != 6 && argc != 4) {
-            fprintf(stderr, "Usage: ./ggsound --merge <first file> <second file> (--name <output name>)\n");
+        if (argc != 4 && argc != 6 && argc != 8) {
+            fprintf(stderr, "Usage: ./ggsound --merge <first file> <second file> (--channels <count | matrix file>) (--name <output name>)\n");
             return 1;
         }
 
         char input1_path[256];
         char input2_path[256];
         char output_path[256];
+        char matrix_path[256];
+        int out_channels = 0;
+        int use_matrix = 0;
 
         snprintf(input1_path, sizeof(input1_path), "%s%s", AUDIO_DIR, argv[2]);
         snprintf(input2_path, sizeof(input2_path), "%s%s", AUDIO_DIR, argv[3]);
+        snprintf(output_path, sizeof(output_path), "%s%s", AUDIO_DIR, "gogi.wav");
+
+        for (int i = 4; i < argc; i++) {
+            if (strcmp(argv[i], "--name") == 0 && i + 1 < argc) {
+                snprintf(output_path, sizeof(output_path), "%s%s", AUDIO_DIR, argv[++i]);
+            } else if (strcmp(argv[i], "--channels") == 0 && i + 1 < argc) {
+                // A count remaps both files, anything else is a matrix file for the second one
+                char *endptr;
+                out_channels = (int)strtol(argv[++i], &endptr, 10);
+                if (*endptr != '\0') {
+                    out_channels = 0;
+                    use_matrix = 1;
+                    snprintf(matrix_path, sizeof(matrix_path), "%s%s", AUDIO_DIR, argv[i]);
+                } else if (out_channels <= 0) {
+                    fprintf(stderr, "Invalid channel count\n");
+                    return 1;
+                }
+            } else {
+                printf("Incorrect arguments\n");
+                fprintf(stderr, "Usage: ./ggsound --merge <first file> <second file> (--channels <count | matrix file>) (--name <output name>)\n");
+                return 1;
+            }
+        }
+
+        return (merge_wav_files_remapped(input1_path, input2_path, output_path, out_channels,
+                                         use_matrix ? matrix_path : NULL) == 0) ? 0 : 1;
+    }
+
+    if (strcmp(argv[1], "--channels") == 0) {
+        if (argc != 6 && argc != 4) {
+            fprintf(stderr, "Usage: ./ggsound --channels <input name> <count | matrix file> (--name <output name>)\n");
+            return 1;
+        }
+
+        char input_path[256];
+        char output_path[256];
+        char matrix_path[256];
+        int out_channels = 0;
+
+        snprintf(input_path, sizeof(input_path), "%s%s", AUDIO_DIR, argv[2]);
+
+        // A plain number is a channel count, anything else is a matrix file
+        char *endptr;
+        out_channels = (int)strtol(argv[3], &endptr, 10);
+        if (*endptr != '\0') {
+            out_channels = 0;
+            snprintf(matrix_path, sizeof(matrix_path), "%s%s", AUDIO_DIR, argv[3]);
+        } else if (out_channels <= 0) {
+            fprintf(stderr, "Invalid channel count\n");
+            return 1;
+        }
 
         if (argc == 6) {
             if (strcmp(argv[4], "--name") == 0) {
                 snprintf(output_path, sizeof(output_path), "%s%s", AUDIO_DIR, argv[5]);
+            } else {
+                printf("Incorrect arguments\n");
+                fprintf(stderr, "Usage: ./ggsound --channels <input name> <count | matrix file> (--name <output name>)\n");
+                return 1;
             }
-            else {
+        } else {
+            snprintf(output_path, sizeof(output_path), "%s%s", AUDIO_DIR, "gogi.wav");
+        }
+
+        return (remap_channels(input_path, output_path, out_channels, out_channels > 0 ? NULL : matrix_path) == 0) ? 0 : 1;
+    }
+
+    if (strcmp(argv[1], "--analyze") == 0) {
+        if (argc != 3) {
+            fprintf(stderr, "Usage: ./ggsound --analyze <input name>\n");
+            return 1;
+        }
+
+        char input_path[256];
+        snprintf(input_path, sizeof(input_path), "%s%s", AUDIO_DIR, argv[2]);
+
+        return (analyze_audio(input_path) == 0) ? 0 : 1;
+    }
+
+    if (strcmp(argv[1], "--normalize") == 0) {
+        if (argc != 6 && argc != 4) {
+            fprintf(stderr, "Usage: ./ggsound --normalize <input name> <target> (--name <output name>)\n");
+            return 1;
+        }
+
+        char input_path[256];
+        char output_path[256];
+        NormalizeMode mode = NORMALIZE_LOUDNESS;
+
+        snprintf(input_path, sizeof(input_path), "%s%s", AUDIO_DIR, argv[2]);
+
+        // Plain numbers and LUFS targets normalize loudness, dB/dBFS targets normalize the peak
+        char *endptr;
+        double target = strtod(argv[3], &endptr);
+        if (endptr == argv[3]) {
+            fprintf(stderr, "Invalid number format for target\n");
+            return 1;
+        }
+        if (strcmp(endptr, "dBFS") == 0 || strcmp(endptr, "dB") == 0) {
+            mode = NORMALIZE_PEAK;
+        } else if (*endptr != '\0' && strcmp(endptr, "LUFS") != 0) {
+            fprintf(stderr, "Invalid target unit \"%s\" (use LUFS or dBFS)\n", endptr);
+            return 1;
+        }
+
+        if (argc == 6) {
+            if (strcmp(argv[4], "--name") == 0) {
+                snprintf(output_path, sizeof(output_path), "%s%s", AUDIO_DIR, argv[5]);
+            } else {
                 printf("Incorrect arguments\n");
-                fprintf(stderr, "Usage: ./ggsound --merge <first file> <second file> (--name <output name>)\n");
+                fprintf(stderr, "Usage: ./ggsound --normalize <input name> <target> (--name <output name>)\n");
                 return 1;
             }
         } else {
             snprintf(output_path, sizeof(output_path), "%s%s", AUDIO_DIR, "gogi.wav");
         }
 
-        merge_wav_files(input1_path, input2_path, output_path);
+        return (normalize_audio(input_path, output_path, target, mode) == 0) ? 0 : 1;
+    }
+
+    if (strcmp(argv[1], "--index") == 0) {
+        if (argc != 3) {
+            fprintf(stderr, "Usage: ./ggsound --index <input name>\n");
+            return 1;
+        }
+
+        char input_path[256];
+        snprintf(input_path, sizeof(input_path), "%s%s", AUDIO_DIR, argv[2]);
+
+        if (peak_index_build(input_path) != 0) {
+            return 1;
+        }
+        printf("Peak index of %s saved to %s%s\n", input_path, input_path, PEAK_INDEX_EXTENSION);
         return 0;
     }
 
+    if (strcmp(argv[1], "--peaks") == 0) {
+        if (argc != 4 && argc != 5) {
+            fprintf(stderr, "Usage: ./ggsound --peaks <input name> ([start:end]) <width>\n");
+            return 1;
+        }
+
+        char input_path[256];
+        double start_time = 0.0;
+        double end_time = -1.0;
+
+        snprintf(input_path, sizeof(input_path), "%s%s", AUDIO_DIR, argv[2]);
+
+        if (argc == 5 && parse_time_range(argv[3], &start_time, &end_time) != 0) {
+            printf("Incorrect arguments\n");
+            fprintf(stderr, "Usage: ./ggsound --peaks <input name> ([start:end]) <width>\n");
+            return 1;
+        }
+
+        char *endptr;
+        long width = strtol(argv[argc - 1], &endptr, 10);
+        if (*endptr != '\0' || width <= 0 || width > 1000000) {
+            fprintf(stderr, "Invalid width\n");
+            return 1;
+        }
+
+        return (print_peaks(input_path, start_time, end_time, (int)width) == 0) ? 0 : 1;
+    }
+
+    if (strcmp(argv[1], "--trim-silence") == 0 || strcmp(argv[1], "--detect-silence") == 0) {
+        const int trim = (strcmp(argv[1], "--trim-silence") == 0);
+        const char *usage = trim ? "Usage: ./ggsound --trim-silence <input name> threshold-db min-ms (--name <output name>)\n"
+                                 : "Usage: ./ggsound --detect-silence <input name> threshold-db min-ms\n";
+        if (trim ? (argc != 5 && argc != 7) : (argc != 5)) {
+            fprintf(stderr, "%s", usage);
+            return 1;
+        }
+
+        char input_path[256];
+        char output_path[256];
+
+        snprintf(input_path, sizeof(input_path), "%s%s", AUDIO_DIR, argv[2]);
+
+        char *endptr;
+        double threshold_db = strtod(argv[3], &endptr);
+        if (*endptr != '\0' || threshold_db > 0) {
+            fprintf(stderr, "Invalid threshold (use dB values at or below 0, e.g. -50)\n");
+            return 1;
+        }
+        double min_ms = strtod(argv[4], &endptr);
+        if (*endptr != '\0' || min_ms < 0) {
+            fprintf(stderr, "Invalid minimum silence length\n");
+            return 1;
+        }
+
+        if (!trim) {
+            return (detect_silence(input_path, threshold_db, min_ms) == 0) ? 0 : 1;
+        }
+
+        if (argc == 7) {
+            if (strcmp(argv[5], "--name") == 0) {
+                snprintf(output_path, sizeof(output_path), "%s%s", AUDIO_DIR, argv[6]);
+            } else {
+                printf("Incorrect arguments\n");
+                fprintf(stderr, "%s", usage);
+                return 1;
+            }
+        } else {
+            snprintf(output_path, sizeof(output_path), "%s%s", AUDIO_DIR, "gogi.wav");
+        }
+
+        return (trim_silence(input_path, output_path, threshold_db, min_ms) == 0) ? 0 : 1;
+    }
+
+    if (strcmp(argv[1], "--mix") == 0) {
+        const char *usage = "Usage: ./ggsound --mix <base file> <overlay>@<offset>:<gain>dB ... (--envelope <envelope file>) (--soft-clip) (--name <output name>)\n";
+        if (argc < 4) {
+            fprintf(stderr, "%s", usage);
+            return 1;
+        }
+
+        char base_path[256];
+        char output_path[256];
+        MixSource sources[MIX_MAX_SOURCES];
+        int source_count = 0;
+        int soft_clip = 0;
+        char envelope_path[256] = "";
+
+        snprintf(base_path, sizeof(base_path), "%s%s", AUDIO_DIR, argv[2]);
+        snprintf(output_path, sizeof(output_path), "%s%s", AUDIO_DIR, "gogi.wav");
+
+        for (int i = 3; i < argc; i++) {
+            if (strcmp(argv[i], "--name") == 0 && i + 1 < argc) {
+                snprintf(output_path, sizeof(output_path), "%s%s", AUDIO_DIR, argv[++i]);
+            } else if (strcmp(argv[i], "--envelope") == 0 && i + 1 < argc) {
+                snprintf(envelope_path, sizeof(envelope_path), "%s%s", AUDIO_DIR, argv[++i]);
+            } else if (strcmp(argv[i], "--soft-clip") == 0) {
+                soft_clip = 1;
+            } else if (source_count < MIX_MAX_SOURCES && parse_mix_source(argv[i], AUDIO_DIR, &sources[source_count]) == 0) {
+                source_count++;
+            } else {
+                printf("Incorrect arguments\n");
+                fprintf(stderr, "%s", usage);
+                return 1;
+            }
+        }
+
+        if (source_count == 0) {
+            fprintf(stderr, "%s", usage);
+            return 1;
+        }
+
+        // The envelope rides the base track before the overlays are summed (ducking)
+        GainEnvelope envelope = {0};
+        if (envelope_path[0] != '\0' && envelope_load(&envelope, envelope_path) != 0) {
+            return 1;
+        }
+
+        int status = mix_wav_files(base_path, sources, source_count, output_path, envelope.count > 0 ? &envelope : NULL, soft_clip);
+        envelope_free(&envelope);
+        return (status == 0) ? 0 : 1;
+    }
+
+    if (strcmp(argv[1], "--envelope") == 0) {
+        if (argc != 6 && argc != 4) {
+            fprintf(stderr, "Usage: ./ggsound --envelope <input name> <envelope file> (--name <output name>)\n");
+            return 1;
+        }
+
+        char input_path[256];
+        char envelope_path[256];
+        char output_path[256];
+
+        snprintf(input_path, sizeof(input_path), "%s%s", AUDIO_DIR, argv[2]);
+        snprintf(envelope_path, sizeof(envelope_path), "%s%s", AUDIO_DIR, argv[3]);
+
+        if (argc == 6) {
+            if (strcmp(argv[4], "--name") == 0) {
+                snprintf(output_path, sizeof(output_path), "%s%s", AUDIO_DIR, argv[5]);
+            } else {
+                printf("Incorrect arguments\n");
+                fprintf(stderr, "Usage: ./ggsound --envelope <input name> <envelope file> (--name <output name>)\n");
+                return 1;
+            }
+        } else {
+            snprintf(output_path, sizeof(output_path), "%s%s", AUDIO_DIR, "gogi.wav");
+        }
+
+        return (apply_envelope(input_path, output_path, envelope_path) == 0) ? 0 : 1;
+    }
+
     char filepath[256];
     snprintf(filepath, sizeof(filepath), "%s%s", AUDIO_DIR, argv[1]);
 
@@ -216,4 +526,49 @@ int main(int argc, char *argv[]) {
 
     return 0;
 }
+
+int main(int argc, char *argv[]) {
+    const char *cache_dir = NULL;
+    long long cache_max_mb = RESULT_CACHE_DEFAULT_MAX_MB;
+
+    // Cache options may appear anywhere, the remaining arguments form the command
+    int count = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc) {
+            cache_dir = argv[++i];
+        } else if (strcmp(argv[i], "--cache-max-mb") == 0 && i + 1 < argc) {
+            char *endptr;
+            cache_max_mb = strtoll(argv[++i], &endptr, 10);
+            if (*endptr != '\0' || cache_max_mb < 0) {
+                fprintf(stderr, "Invalid cache size\n");
+                return 1;
+            }
+        } else {
+            argv[count++] = argv[i];
+        }
+    }
+    argv[count] = NULL;
+    argc = count;
+
+    const int show_stats = (argc == 2 && strcmp(argv[1], "--cache-stats") == 0);
+    if (!cache_dir) {
+        if (show_stats) {
+            fprintf(stderr, "Usage: ./ggsound --cache-stats --cache-dir <directory>\n");
+            return 1;
+        }
+        return run_command(argc, argv);
+    }
+
+    ResultCache cache;
+    if (result_cache_open(&cache, cache_dir, cache_max_mb * 1024 * 1024) != 0) {
+        return 1;
+    }
+
+    if (show_stats) {
+        result_cache_print_stats(&cache);
+        return 0;
+    }
+
+    return result_cache_run(&cache, argc, argv, AUDIO_DIR, run_command);
+}
 #endif
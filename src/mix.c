@@ -0,0 +1,330 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sndfile.h>
+#include "mix.h"
+#include "channel_matrix.h"
+#include "envelope.h"
+#include "audio_block.h"
+#include "audio_processing.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Number of frames mixed per step
+#define MIX_CHUNK_FRAMES 4096
+
+// Level above which the soft clipper starts bending the signal
+#define SOFT_CLIP_KNEE 0.9f
+
+// Streaming state of one overlay
+typedef struct {
+    const MixSource *source;
+    SNDFILE *file;          // Open only while the overlay window is active
+    SF_INFO info;
+    sf_count_t start_frame; // Window [start_frame, end_frame) in base-track frames
+    sf_count_t end_frame;
+    float gain;
+    ChannelMatrix matrix;   // Remaps the overlay onto the base layout when the channel counts differ
+    float *buffer;
+    float *remapped;
+    int done;
+} MixVoice;
+
+// Function to parse "name.wav@offset:gain"
+int parse_mix_source(const char *arg, const char *directory, MixSource *source) {
+    const char *at = strrchr(arg, '@');
+    size_t name_length = at ? (size_t)(at - arg) : strlen(arg);
+
+    source->offset = 0.0;
+    source->gain_db = 0.0;
+    if (name_length == 0 || strlen(directory) + name_length >= sizeof(source->path)) {
+        return -1;
+    }
+    snprintf(source->path, sizeof(source->path), "%s%.*s", directory, (int)name_length, arg);
+
+    if (!at) {
+        return 0;
+    }
+
+    char *endptr;
+    source->offset = strtod(at + 1, &endptr);
+    if (endptr == at + 1 || source->offset < 0) {
+        return -1;
+    }
+
+    if (*endptr == ':') {
+        const char *gain = endptr + 1;
+        source->gain_db = strtod(gain, &endptr);
+        if (endptr == gain) {
+            return -1;
+        }
+        if (strcmp(endptr, "dB") == 0 || strcmp(endptr, "db") == 0) {
+            endptr += 2;
+        }
+    }
+
+    return (*endptr == '\0') ? 0 : -1;
+}
+
+// Function to add gain * source onto destination
+void mix_add_scaled(float *destination, const float *source, sf_count_t count, float gain) {
+    sf_count_t i = 0;
+#if defined(__SSE2__)
+    const __m128 gain_vector = _mm_set1_ps(gain);
+    for (; i + 4 <= count; i += 4) {
+        __m128 sum = _mm_add_ps(_mm_loadu_ps(destination + i), _mm_mul_ps(_mm_loadu_ps(source + i), gain_vector));
+        _mm_storeu_ps(destination + i, sum);
+    }
+#endif
+    for (; i < count; ++i) {
+        destination[i] += source[i] * gain;
+    }
+}
+
+// Function to bend a single sample above the knee towards full scale
+static float soft_clip_sample(float x) {
+    const float magnitude = fabsf(x);
+    if (magnitude <= SOFT_CLIP_KNEE) {
+        return x;
+    }
+    const float range = 1.0f - SOFT_CLIP_KNEE;
+    const float bent = SOFT_CLIP_KNEE + range * tanhf((magnitude - SOFT_CLIP_KNEE) / range);
+    return (x < 0) ? -bent : bent;
+}
+
+// Function to softly limit samples above the knee
+void soft_clip_samples(float *samples, sf_count_t count) {
+    sf_count_t i = 0;
+#if defined(__SSE2__)
+    // Most groups stay below the knee, only the others take the scalar curve
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 knee = _mm_set1_ps(SOFT_CLIP_KNEE);
+    for (; i + 4 <= count; i += 4) {
+        __m128 magnitude = _mm_and_ps(_mm_loadu_ps(samples + i), abs_mask);
+        if (_mm_movemask_ps(_mm_cmpgt_ps(magnitude, knee))) {
+            for (int j = 0; j < 4; ++j) {
+                samples[i + j] = soft_clip_sample(samples[i + j]);
+            }
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        samples[i] = soft_clip_sample(samples[i]);
+    }
+}
+
+// Function to close an overlay and release its buffers
+static void mix_voice_close(MixVoice *voice) {
+    if (voice->file) {
+        sf_close(voice->file);
+        voice->file = NULL;
+    }
+    if (voice->matrix.coeffs) {
+        channel_matrix_free(&voice->matrix);
+    }
+    free(voice->buffer);
+    free(voice->remapped);
+    voice->buffer = NULL;
+    voice->remapped = NULL;
+    voice->done = 1;
+}
+
+// Function to open an overlay when its window starts
+static int mix_voice_open(MixVoice *voice, int out_channels) {
+    voice->file = sf_open(voice->source->path, SFM_READ, &voice->info);
+    if (!voice->file) {
+        fprintf(stderr, "Error: Could not open overlay file %s\n", voice->source->path);
+        return -1;
+    }
+
+    voice->buffer = (float *)malloc((size_t)MIX_CHUNK_FRAMES * voice->info.channels * sizeof(float));
+    if (voice->info.channels != out_channels) {
+        voice->remapped = (float *)malloc((size_t)MIX_CHUNK_FRAMES * out_channels * sizeof(float));
+        if (channel_matrix_init_default(&voice->matrix, voice->info.channels, out_channels) != 0) {
+            fprintf(stderr, "Error: No default %d -> %d channel matrix for overlay %s\n",
+                    voice->info.channels, out_channels, voice->source->path);
+            voice->matrix.coeffs = NULL;
+            mix_voice_close(voice);
+            return -1;
+        }
+    }
+    if (!voice->buffer || (voice->info.channels != out_channels && !voice->remapped)) {
+        fprintf(stderr, "Error: Could not allocate memory for buffer.\n");
+        mix_voice_close(voice);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Function to mix overlays onto a base track in one streaming pass
+int mix_wav_files(const char *base_path, const MixSource *sources, int source_count, const char *output_path,
+                  const GainEnvelope *base_envelope, int soft_clip) {
+    SF_INFO base_info = {0};
+
+    SNDFILE *base_file = sf_open(base_path, SFM_READ, &base_info);
+    if (!base_file) {
+        fprintf(stderr, "Error: Could not open base file %s\n", base_path);
+        return -1;
+    }
+
+    const int channels = base_info.channels;
+    MixVoice *voices = (MixVoice *)calloc(source_count > 0 ? source_count : 1, sizeof(MixVoice));
+    float *mix = (float *)malloc((size_t)MIX_CHUNK_FRAMES * channels * sizeof(float));
+    if (!voices || !mix) {
+        fprintf(stderr, "Error: Could not allocate memory for buffer.\n");
+        free(voices);
+        free(mix);
+        sf_close(base_file);
+        return -1;
+    }
+
+    // Planar block for the envelope stage on the base track
+    AudioBlock block = {0};
+    if (base_envelope && audio_block_init(&block, channels, MIX_CHUNK_FRAMES) != 0) {
+        fprintf(stderr, "Error: Could not allocate memory for buffer.\n");
+        free(voices);
+        free(mix);
+        sf_close(base_file);
+        return -1;
+    }
+
+    // Check every overlay up front (header only) and place its window on the base timeline
+    sf_count_t total_frames = base_info.frames;
+    for (int s = 0; s < source_count; ++s) {
+        MixVoice *voice = &voices[s];
+        SF_INFO info = {0};
+        SNDFILE *file = sf_open(sources[s].path, SFM_READ, &info);
+        if (!file) {
+            fprintf(stderr, "Error: Could not open overlay file %s\n", sources[s].path);
+            audio_block_free(&block);
+            free(voices);
+            free(mix);
+            sf_close(base_file);
+            return -1;
+        }
+        sf_close(file);
+
+        if (info.samplerate != base_info.samplerate) {
+            fprintf(stderr, "Error: Overlay %s has a different sample rate: %d Hz vs %d Hz\n",
+                    sources[s].path, info.samplerate, base_info.samplerate);
+            audio_block_free(&block);
+            free(voices);
+            free(mix);
+            sf_close(base_file);
+            return -1;
+        }
+
+        // Overlays in another layout are remapped with the default matrix, which does not cover every pair
+        ChannelMatrix matrix;
+        if (info.channels != channels && channel_matrix_init_default(&matrix, info.channels, channels) != 0) {
+            fprintf(stderr, "Error: Overlay %s has %d channels and there is no default %d -> %d channel matrix, "
+                    "remap it first with --channels <count | matrix file>\n",
+                    sources[s].path, info.channels, info.channels, channels);
+            audio_block_free(&block);
+            free(voices);
+            free(mix);
+            sf_close(base_file);
+            return -1;
+        }
+        if (info.channels != channels) {
+            channel_matrix_free(&matrix);
+        }
+
+        voice->source = &sources[s];
+        voice->start_frame = (sf_count_t)(sources[s].offset * base_info.samplerate + 0.5);
+        voice->end_frame = voice->start_frame + info.frames;
+        voice->gain = (float)pow(10.0, sources[s].gain_db / 20.0);
+        if (voice->end_frame > total_frames) {
+            total_frames = voice->end_frame;
+        }
+    }
+
+    OutputFile output;
+    SNDFILE *output_file = open_output_file(&output, output_path, &base_info);
+    if (!output_file) {
+        fprintf(stderr, "Error: Could not open output file %s\n", output_path);
+        audio_block_free(&block);
+        free(voices);
+        free(mix);
+        sf_close(base_file);
+        return -1;
+    }
+    sf_command(output_file, SFC_SET_CLIPPING, NULL, SF_TRUE); // Hard clip instead of wrapping when the sum overshoots
+
+    // Stream the timeline: base first, then every overlay active in this chunk
+    int status = 0;
+    for (sf_count_t position = 0; position < total_frames && status == 0; position += MIX_CHUNK_FRAMES) {
+        const sf_count_t frames = (total_frames - position < MIX_CHUNK_FRAMES) ? total_frames - position : MIX_CHUNK_FRAMES;
+
+        sf_count_t base_frames = sf_readf_float(base_file, mix, frames);
+        if (base_frames < 0) base_frames = 0;
+        memset(mix + base_frames * channels, 0, (size_t)(frames - base_frames) * channels * sizeof(float));
+
+        // Ride the base level (e.g. ducking under a voice-over) where the envelope is not at 0 dB
+        if (base_envelope && base_frames > 0 &&
+            !envelope_is_unity(base_envelope, base_info.samplerate, position, position + base_frames)) {
+            audio_block_deinterleave(&block, mix, base_frames);
+            envelope_apply_block(base_envelope, base_info.samplerate, &block, position);
+            audio_block_interleave(&block, mix);
+        }
+
+        for (int s = 0; s < source_count; ++s) {
+            MixVoice *voice = &voices[s];
+            if (voice->done || voice->start_frame >= position + frames) {
+                continue;
+            }
+            if (!voice->file && mix_voice_open(voice, channels) != 0) {
+                status = -1;
+                break;
+            }
+
+            const sf_count_t offset = (voice->start_frame > position) ? voice->start_frame - position : 0;
+            const sf_count_t wanted = frames - offset;
+            sf_count_t read_frames = sf_readf_float(voice->file, voice->buffer, wanted);
+            if (read_frames > 0) {
+                const float *samples = voice->buffer;
+                if (voice->remapped) {
+                    channel_matrix_apply(&voice->matrix, voice->buffer, voice->remapped, read_frames);
+                    samples = voice->remapped;
+                }
+                mix_add_scaled(mix + offset * channels, samples, read_frames * channels, voice->gain);
+            }
+
+            // Release the overlay as soon as its window is over
+            if (read_frames < wanted || voice->end_frame <= position + frames) {
+                mix_voice_close(voice);
+            }
+        }
+
+        if (soft_clip) {
+            soft_clip_samples(mix, frames * channels);
+        }
+
+        if (sf_writef_float(output_file, mix, frames) != frames) {
+            fprintf(stderr, "Error: Could not write all samples to the output file.\n");
+            status = -1;
+        }
+    }
+
+    // Clean up
+    for (int s = 0; s < source_count; ++s) {
+        if (!voices[s].done) {
+            mix_voice_close(&voices[s]);
+        }
+    }
+    audio_block_free(&block);
+    free(voices);
+    free(mix);
+    sf_close(base_file);
+
+    if (close_output_file(&output, status) != 0) {
+        return -1;
+    }
+
+    printf("Mixed %d overlay(s) onto %s and saved to %s\n", source_count, base_path, output_path);
+    return 0;
+}
@@ -0,0 +1,30 @@
+#ifndef MIX_H
+#define MIX_H
+
+#include <sndfile.h>
+#include "envelope.h"
+
+// Largest number of overlays accepted by one mix
+#define MIX_MAX_SOURCES 64
+
+// Overlay laid on top of the base track
+typedef struct {
+    char path[256];
+    double offset;   // Start position in the base track, seconds
+    double gain_db;  // Gain applied to the overlay
+} MixSource;
+
+// Function to parse "name.wav@offset:gain" (offset and gain optional, gain may end in dB)
+int parse_mix_source(const char *arg, const char *directory, MixSource *source);
+
+// Function to add gain * source onto destination
+void mix_add_scaled(float *destination, const float *source, sf_count_t count, float gain);
+
+// Function to softly limit samples above the knee so the sum never exceeds full scale
+void soft_clip_samples(float *samples, sf_count_t count);
+
+// Function to mix overlays onto a base track in one streaming pass (base_envelope, if set, rides the base before summing)
+int mix_wav_files(const char *base_path, const MixSource *sources, int source_count, const char *output_path,
+                  const GainEnvelope *base_envelope, int soft_clip);
+
+#endif // MIX_H
@@ -0,0 +1,559 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <sndfile.h>
+#include "peak_index.h"
+#include "audio_block.h"
+#include "audio_processing.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+// Format version written to the header, bumped whenever the layout changes
+#define PEAK_INDEX_VERSION 2
+
+// Function to get the modification time of a file in nanoseconds (seconds only where the platform has no finer stamp)
+static int64_t source_mtime_ns(const struct stat *source_stat) {
+#if defined(__linux__)
+    return (int64_t)source_stat->st_mtim.tv_sec * 1000000000 + source_stat->st_mtim.tv_nsec;
+#elif defined(__APPLE__)
+    return (int64_t)source_stat->st_mtimespec.tv_sec * 1000000000 + source_stat->st_mtimespec.tv_nsec;
+#else
+    return (int64_t)source_stat->st_mtime * 1000000000;
+#endif
+}
+
+// Function to build the sidecar path of an input file
+static void peak_index_path(const char *input_path, char *index_path, size_t size) {
+    snprintf(index_path, size, "%s%s", input_path, PEAK_INDEX_EXTENSION);
+}
+
+// Function to summarise one bucket of a lane
+static PeakEntry lane_bucket(const float *lane, sf_count_t count) {
+    sf_count_t i = 0;
+    float min = lane[0];
+    float max = lane[0];
+    float sum_squares = 0.0f;
+
+#if defined(__SSE2__)
+    if (count >= 4) {
+        __m128 min_vector = _mm_loadu_ps(lane);
+        __m128 max_vector = min_vector;
+        __m128 squares_vector = _mm_setzero_ps();
+        for (; i + 4 <= count; i += 4) {
+            __m128 x = _mm_loadu_ps(lane + i);
+            min_vector = _mm_min_ps(min_vector, x);
+            max_vector = _mm_max_ps(max_vector, x);
+            squares_vector = _mm_add_ps(squares_vector, _mm_mul_ps(x, x));
+        }
+
+        float mins[4], maxs[4], squares[4];
+        _mm_storeu_ps(mins, min_vector);
+        _mm_storeu_ps(maxs, max_vector);
+        _mm_storeu_ps(squares, squares_vector);
+        for (int j = 0; j < 4; ++j) {
+            if (mins[j] < min) min = mins[j];
+            if (maxs[j] > max) max = maxs[j];
+            sum_squares += squares[j];
+        }
+    }
+#endif
+
+    for (; i < count; ++i) {
+        if (lane[i] < min) min = lane[i];
+        if (lane[i] > max) max = lane[i];
+        sum_squares += lane[i] * lane[i];
+    }
+
+    PeakEntry entry = {min, max, sqrtf(sum_squares / (float)count)};
+    return entry;
+}
+
+// Function to merge the entries of consecutive buckets, weighting the RMS by their frame counts
+static PeakEntry merge_buckets(const PeakEntry *entries, int channels, int channel, sf_count_t first, sf_count_t last,
+                               sf_count_t bucket_frames, sf_count_t total_frames) {
+    PeakEntry merged = entries[first * channels + channel];
+    double energy = 0.0;
+    sf_count_t frames = 0;
+
+    for (sf_count_t b = first; b <= last; ++b) {
+        const PeakEntry *entry = &entries[b * channels + channel];
+        sf_count_t bucket_start = b * bucket_frames;
+        sf_count_t count = (bucket_start + bucket_frames <= total_frames) ? bucket_frames : total_frames - bucket_start;
+        if (entry->min < merged.min) merged.min = entry->min;
+        if (entry->max > merged.max) merged.max = entry->max;
+        energy += (double)entry->rms * entry->rms * count;
+        frames += count;
+    }
+
+    merged.rms = (frames > 0) ? (float)sqrt(energy / frames) : 0.0f;
+    return merged;
+}
+
+// Function to build the sidecar index of a file in one streaming pass
+int peak_index_build(const char *input_path) {
+    SF_INFO sfinfo = {0};
+    struct stat source_stat;
+
+    if (stat(input_path, &source_stat) != 0) {
+        fprintf(stderr, "Error: Could not open input file %s\n", input_path);
+        return -1;
+    }
+
+    SNDFILE *input_file = sf_open(input_path, SFM_READ, &sfinfo);
+    if (!input_file) {
+        fprintf(stderr, "Error: Could not open input file %s\n", input_path);
+        return -1;
+    }
+
+    const int channels = sfinfo.channels;
+    const sf_count_t base_buckets = (sfinfo.frames + PEAK_INDEX_BASE_FRAMES - 1) / PEAK_INDEX_BASE_FRAMES;
+
+    // Lay out the pyramid: every level is PEAK_INDEX_LEVEL_FACTOR times coarser, down to a single bucket
+    PeakIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "GGPK", 4);
+    header.version = PEAK_INDEX_VERSION;
+    header.channels = channels;
+    header.samplerate = sfinfo.samplerate;
+    header.source_size = (uint64_t)source_stat.st_size;
+    header.source_mtime_ns = source_mtime_ns(&source_stat);
+    header.source_inode = (uint64_t)source_stat.st_ino;
+    header.base_frames = PEAK_INDEX_BASE_FRAMES;
+    header.level_factor = PEAK_INDEX_LEVEL_FACTOR;
+
+    uint64_t buckets = base_buckets > 0 ? (uint64_t)base_buckets : 1;
+    uint64_t offset = sizeof(PeakIndexHeader);
+    uint64_t total_entries = 0;
+    do {
+        header.level_offset[header.level_count] = offset;
+        header.level_buckets[header.level_count] = buckets;
+        offset += buckets * channels * sizeof(PeakEntry);
+        total_entries += buckets * channels;
+        header.level_count++;
+        buckets = (buckets + PEAK_INDEX_LEVEL_FACTOR - 1) / PEAK_INDEX_LEVEL_FACTOR;
+    } while (header.level_buckets[header.level_count - 1] > 1 && header.level_count < PEAK_INDEX_MAX_LEVELS);
+
+    AudioBlock block;
+    PeakEntry *entries = (PeakEntry *)calloc(total_entries, sizeof(PeakEntry));
+    if (!entries || audio_block_init(&block, channels, AUDIO_BLOCK_FRAMES) != 0) {
+        fprintf(stderr, "Error: Could not allocate memory for peak index.\n");
+        free(entries);
+        sf_close(input_file);
+        return -1;
+    }
+
+    // Finest level straight from the samples (AUDIO_BLOCK_FRAMES is a multiple of the bucket size)
+    sf_count_t position = 0;
+    sf_count_t read_frames;
+    while ((read_frames = audio_block_read(&block, input_file)) > 0) {
+        const sf_count_t first_bucket = position / PEAK_INDEX_BASE_FRAMES;
+        const sf_count_t block_buckets = (read_frames + PEAK_INDEX_BASE_FRAMES - 1) / PEAK_INDEX_BASE_FRAMES;
+
+        if (first_bucket + block_buckets > (sf_count_t)header.level_buckets[0]) {
+            break; // More frames than the header announced
+        }
+
+        #pragma omp parallel for schedule(static) if (channels >= AUDIO_BLOCK_PARALLEL_CHANNELS)
+        for (int ch = 0; ch < channels; ++ch) {
+            for (sf_count_t b = 0; b < block_buckets; ++b) {
+                sf_count_t start = b * PEAK_INDEX_BASE_FRAMES;
+                sf_count_t count = (start + PEAK_INDEX_BASE_FRAMES <= read_frames) ? PEAK_INDEX_BASE_FRAMES : read_frames - start;
+                entries[(first_bucket + b) * channels + ch] = lane_bucket(block.lanes[ch] + start, count);
+            }
+        }
+        position += read_frames;
+    }
+    header.frames = (uint64_t)position;
+
+    audio_block_free(&block);
+    sf_close(input_file);
+
+    // Coarser levels from the level below
+    sf_count_t bucket_frames = PEAK_INDEX_BASE_FRAMES;
+    for (uint32_t level = 1; level < header.level_count; ++level) {
+        const PeakEntry *below = entries + (header.level_offset[level - 1] - sizeof(PeakIndexHeader)) / sizeof(PeakEntry);
+        PeakEntry *current = entries + (header.level_offset[level] - sizeof(PeakIndexHeader)) / sizeof(PeakEntry);
+        const sf_count_t below_buckets = (sf_count_t)header.level_buckets[level - 1];
+
+        for (sf_count_t b = 0; b < (sf_count_t)header.level_buckets[level]; ++b) {
+            sf_count_t first = b * PEAK_INDEX_LEVEL_FACTOR;
+            sf_count_t last = first + PEAK_INDEX_LEVEL_FACTOR - 1;
+            if (last >= below_buckets) last = below_buckets - 1;
+            for (int ch = 0; ch < channels; ++ch) {
+                current[b * channels + ch] = merge_buckets(below, channels, ch, first, last, bucket_frames, position);
+            }
+        }
+        bucket_frames *= PEAK_INDEX_LEVEL_FACTOR;
+    }
+
+    // Write the sidecar to a temp file and rename it into place, readers keep mapping the previous one meanwhile
+    char index_path[512];
+    char temp_path[600];
+    peak_index_path(input_path, index_path, sizeof(index_path));
+    output_temp_path(index_path, temp_path, sizeof(temp_path));
+    FILE *index_file = fopen(temp_path, "wb");
+    if (!index_file) {
+        fprintf(stderr, "Error: Could not open index file %s\n", temp_path);
+        free(entries);
+        return -1;
+    }
+
+    int status = 0;
+    if (fwrite(&header, sizeof(header), 1, index_file) != 1 ||
+        fwrite(entries, sizeof(PeakEntry), total_entries, index_file) != total_entries) {
+        fprintf(stderr, "Error: Could not write index file %s\n", index_path);
+        status = -1;
+    }
+
+    // Clean up
+    if (fclose(index_file) != 0) {
+        status = -1;
+    }
+    free(entries);
+    if (status != 0) {
+        remove(temp_path);
+    } else {
+        status = replace_file(temp_path, index_path);
+    }
+
+    return status;
+}
+
+// Function to check that a mapped index is complete and still describes the input file
+static int peak_index_valid(const PeakIndex *index, const struct stat *source_stat) {
+    const PeakIndexHeader *header = index->header;
+
+    if (index->size < sizeof(PeakIndexHeader) || memcmp(header->magic, "GGPK", 4) != 0 ||
+        header->version != PEAK_INDEX_VERSION || header->channels == 0 ||
+        header->level_count == 0 || header->level_count > PEAK_INDEX_MAX_LEVELS) {
+        return 0;
+    }
+
+    // Same-size rewrites within one second (e.g. an in-place gain) still change the nanosecond stamp
+    if (header->source_size != (uint64_t)source_stat->st_size || header->source_mtime_ns != source_mtime_ns(source_stat) ||
+        header->source_inode != (uint64_t)source_stat->st_ino) {
+        return 0;
+    }
+
+    const uint32_t last = header->level_count - 1;
+    uint64_t end = header->level_offset[last] + header->level_buckets[last] * header->channels * sizeof(PeakEntry);
+    return end <= index->size;
+}
+
+// Function to map an index file into memory
+static int peak_index_map(const char *index_path, PeakIndex *index) {
+#if defined(_WIN32)
+    FILE *file = fopen(index_path, "rb");
+    if (!file) {
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    index->data = (size > 0) ? malloc(size) : NULL;
+    if (!index->data || fread(index->data, 1, size, file) != (size_t)size) {
+        free(index->data);
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+    index->size = (size_t)size;
+    index->mapped = 0;
+#else
+    int fd = open(index_path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat index_stat;
+    if (fstat(fd, &index_stat) != 0 || index_stat.st_size <= 0) {
+        close(fd);
+        return -1;
+    }
+    void *data = mmap(NULL, (size_t)index_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+    index->data = data;
+    index->size = (size_t)index_stat.st_size;
+    index->mapped = 1;
+#endif
+    index->header = (const PeakIndexHeader *)index->data;
+    return 0;
+}
+
+// Function to open the sidecar index of a file
+int peak_index_open(const char *input_path, PeakIndex *index, int build) {
+    struct stat source_stat;
+    char index_path[512];
+
+    memset(index, 0, sizeof(*index));
+    if (stat(input_path, &source_stat) != 0) {
+        return -1;
+    }
+    peak_index_path(input_path, index_path, sizeof(index_path));
+
+    if (peak_index_map(index_path, index) == 0) {
+        if (peak_index_valid(index, &source_stat)) {
+            return 0;
+        }
+        peak_index_close(index);
+    }
+
+    // Missing or stale: rebuild once and map the fresh file
+    if (!build || peak_index_build(input_path) != 0) {
+        return -1;
+    }
+    if (peak_index_map(index_path, index) != 0) {
+        return -1;
+    }
+    if (!peak_index_valid(index, &source_stat)) {
+        peak_index_close(index);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Function to release an opened index
+void peak_index_close(PeakIndex *index) {
+    if (index->data) {
+#if defined(_WIN32)
+        free(index->data);
+#else
+        if (index->mapped) {
+            munmap(index->data, index->size);
+        } else {
+            free(index->data);
+        }
+#endif
+    }
+    memset(index, 0, sizeof(*index));
+}
+
+// Function to get the frame count covered by one bucket of a level
+sf_count_t peak_index_bucket_frames(const PeakIndex *index, int level) {
+    sf_count_t frames = index->header->base_frames;
+    for (int l = 0; l < level; ++l) {
+        frames *= index->header->level_factor;
+    }
+    return frames;
+}
+
+// Function to get the entries of a level
+const PeakEntry *peak_index_level(const PeakIndex *index, int level) {
+    return (const PeakEntry *)((const char *)index->data + index->header->level_offset[level]);
+}
+
+// Running min/max/energy of one channel while a column is assembled
+typedef struct {
+    float min;
+    float max;
+    double energy;
+    sf_count_t frames;
+} PeakAccumulator;
+
+// Function to add one summarised stretch of frames to an accumulator
+static void accumulate_entry(PeakAccumulator *accumulator, const PeakEntry *entry, sf_count_t frames) {
+    if (accumulator->frames == 0 || entry->min < accumulator->min) accumulator->min = entry->min;
+    if (accumulator->frames == 0 || entry->max > accumulator->max) accumulator->max = entry->max;
+    accumulator->energy += (double)entry->rms * entry->rms * frames;
+    accumulator->frames += frames;
+}
+
+// Function to decode frames [from, to) of the source into the accumulators, returns 0 on success
+static int accumulate_samples(SNDFILE *source, int channels, sf_count_t from, sf_count_t to, float *buffer,
+                              PeakAccumulator *accumulators) {
+    const sf_count_t frames = to - from;
+    if (!source || sf_seek(source, from, SEEK_SET) != from || sf_readf_float(source, buffer, frames) != frames) {
+        return -1;
+    }
+
+    for (int ch = 0; ch < channels; ++ch) {
+        PeakEntry entry = {buffer[ch], buffer[ch], 0.0f};
+        double energy = 0.0;
+        for (sf_count_t i = 0; i < frames; ++i) {
+            const float sample = buffer[i * channels + ch];
+            if (sample < entry.min) entry.min = sample;
+            if (sample > entry.max) entry.max = sample;
+            energy += (double)sample * sample;
+        }
+        entry.rms = (float)sqrt(energy / frames);
+        accumulate_entry(&accumulators[ch], &entry, frames);
+    }
+    return 0;
+}
+
+// Function to summarise frames [from, to) exactly: whole buckets of this level inside the range are used as
+// they are, the partial edges are taken from finer levels and, below the finest one, decoded from the source
+static void accumulate_range(const PeakIndex *index, SNDFILE *source, int level, sf_count_t from, sf_count_t to,
+                             float *buffer, PeakAccumulator *accumulators) {
+    const PeakIndexHeader *header = index->header;
+    const int channels = (int)header->channels;
+    const sf_count_t total_frames = (sf_count_t)header->frames;
+
+    if (to <= from) {
+        return;
+    }
+
+    const PeakEntry *entries = peak_index_level(index, level);
+    const sf_count_t bucket_frames = peak_index_bucket_frames(index, level);
+    const sf_count_t bucket_count = (sf_count_t)header->level_buckets[level];
+
+    // Buckets [first, end) lie completely inside the range (the last bucket of the file ends at total_frames)
+    sf_count_t first = (from + bucket_frames - 1) / bucket_frames;
+    sf_count_t end = (to >= total_frames) ? bucket_count : to / bucket_frames;
+    if (end > bucket_count) end = bucket_count;
+
+    if (first >= end) {
+        if (level > 0) {
+            accumulate_range(index, source, level - 1, from, to, buffer, accumulators);
+        } else if (accumulate_samples(source, channels, from, to, buffer, accumulators) != 0) {
+            // Without the source the overlapping finest buckets are the closest summary available
+            sf_count_t last = (to - 1) / bucket_frames;
+            for (int ch = 0; ch < channels; ++ch) {
+                PeakEntry entry = merge_buckets(entries, channels, ch, from / bucket_frames, last, bucket_frames, total_frames);
+                accumulate_entry(&accumulators[ch], &entry, to - from);
+            }
+        }
+        return;
+    }
+
+    const sf_count_t full_start = first * bucket_frames;
+    const sf_count_t full_end = (end * bucket_frames < total_frames) ? end * bucket_frames : total_frames;
+    for (int ch = 0; ch < channels; ++ch) {
+        PeakEntry entry = merge_buckets(entries, channels, ch, first, end - 1, bucket_frames, total_frames);
+        accumulate_entry(&accumulators[ch], &entry, full_end - full_start);
+    }
+
+    const int finer = (level > 0) ? level - 1 : 0;
+    accumulate_range(index, source, finer, from, full_start, buffer, accumulators);
+    accumulate_range(index, source, finer, full_end, to, buffer, accumulators);
+}
+
+// Function to move a column bound to the nearest bucket boundary of the finest level
+static sf_count_t snap_to_bucket(sf_count_t frame, sf_count_t bucket_frames, sf_count_t total_frames) {
+    const sf_count_t snapped = (frame + bucket_frames / 2) / bucket_frames * bucket_frames;
+    return (snapped < total_frames) ? snapped : total_frames;
+}
+
+// Function to summarise frames [start_frame, end_frame) into width columns
+int peak_index_query(const PeakIndex *index, SNDFILE *source, sf_count_t start_frame, sf_count_t end_frame, int width,
+                      PeakEntry *columns) {
+    const PeakIndexHeader *header = index->header;
+    const int channels = (int)header->channels;
+    const sf_count_t total_frames = (sf_count_t)header->frames;
+
+    if (start_frame < 0) start_frame = 0;
+    if (end_frame > total_frames) end_frame = total_frames;
+    if (end_frame <= start_frame || width <= 0) {
+        memset(columns, 0, (size_t)(width > 0 ? width : 0) * channels * sizeof(PeakEntry));
+        return 0;
+    }
+
+    // Use the coarsest level whose buckets are still no wider than one column
+    const double frames_per_column = (double)(end_frame - start_frame) / width;
+    int level = 0;
+    while (level + 1 < (int)header->level_count && peak_index_bucket_frames(index, level + 1) <= frames_per_column) {
+        level++;
+    }
+
+    // Edges finer than one bucket are decoded, never longer than two buckets of the finest level
+    float *buffer = (float *)malloc((size_t)2 * header->base_frames * channels * sizeof(float));
+    PeakAccumulator *accumulators = (PeakAccumulator *)malloc((size_t)channels * sizeof(PeakAccumulator));
+    if (!buffer || !accumulators) {
+        fprintf(stderr, "Error: Could not allocate memory for peaks.\n");
+        free(buffer);
+        free(accumulators);
+        return -1;
+    }
+
+    for (int column = 0; column < width; ++column) {
+        sf_count_t column_start = start_frame + (sf_count_t)(frames_per_column * column);
+        sf_count_t column_end = start_frame + (sf_count_t)(frames_per_column * (column + 1));
+        if (column == width - 1 || column_end > end_frame) column_end = end_frame;
+        if (column_end <= column_start) column_end = column_start + 1;
+
+        // Without a source the bounds move to the nearest finest bucket (off by at most half a bucket), so
+        // every column is served from the index alone
+        if (!source) {
+            const sf_count_t base_frames = (sf_count_t)header->base_frames;
+            column_start = snap_to_bucket(column_start, base_frames, total_frames);
+            column_end = snap_to_bucket(column_end, base_frames, total_frames);
+            if (column_end <= column_start) {
+                if (column_start + base_frames < total_frames) {
+                    column_end = column_start + base_frames;
+                } else {
+                    column_end = total_frames;
+                    column_start = (total_frames - 1) / base_frames * base_frames;
+                }
+            }
+        }
+
+        memset(accumulators, 0, (size_t)channels * sizeof(PeakAccumulator));
+        accumulate_range(index, source, level, column_start, column_end, buffer, accumulators);
+        for (int ch = 0; ch < channels; ++ch) {
+            PeakEntry *entry = &columns[column * channels + ch];
+            entry->min = accumulators[ch].min;
+            entry->max = accumulators[ch].max;
+            entry->rms = (accumulators[ch].frames > 0) ? (float)sqrt(accumulators[ch].energy / accumulators[ch].frames) : 0.0f;
+        }
+    }
+
+    free(buffer);
+    free(accumulators);
+    return 0;
+}
+
+// Function to print the min/max/RMS overview of a time range
+int print_peaks(const char *input_path, double start_time, double end_time, int width) {
+    PeakIndex index;
+
+    if (peak_index_open(input_path, &index, 1) != 0) {
+        fprintf(stderr, "Error: Could not open or build the peak index of %s\n", input_path);
+        return -1;
+    }
+
+    const int channels = (int)index.header->channels;
+    const double samplerate = index.header->samplerate;
+    sf_count_t start_frame = (sf_count_t)(start_time * samplerate + 0.5);
+    sf_count_t end_frame = (end_time > 0) ? (sf_count_t)(end_time * samplerate + 0.5) : (sf_count_t)index.header->frames;
+
+    PeakEntry *columns = (PeakEntry *)malloc((size_t)width * channels * sizeof(PeakEntry));
+    if (!columns) {
+        fprintf(stderr, "Error: Could not allocate memory for peaks.\n");
+        peak_index_close(&index);
+        return -1;
+    }
+
+    // An overview is drawn from the index alone, column edges snap to the finest buckets
+    if (peak_index_query(&index, NULL, start_frame, end_frame, width, columns) != 0) {
+        free(columns);
+        peak_index_close(&index);
+        return -1;
+    }
+
+    // One line per column: min, max and RMS of every channel
+    for (int column = 0; column < width; ++column) {
+        printf("%d", column);
+        for (int ch = 0; ch < channels; ++ch) {
+            const PeakEntry *entry = &columns[column * channels + ch];
+            printf(" %.4f %.4f %.4f", entry->min, entry->max, entry->rms);
+        }
+        printf("\n");
+    }
+
+    free(columns);
+    peak_index_close(&index);
+    return 0;
+}
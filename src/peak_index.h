@@ -0,0 +1,77 @@
+#ifndef PEAK_INDEX_H
+#define PEAK_INDEX_H
+
+#include <stdint.h>
+#include <sndfile.h>
+
+// Extension appended to the input path to name its sidecar index
+#define PEAK_INDEX_EXTENSION ".ggpk"
+
+// Frames summarised by one bucket of the finest level
+#define PEAK_INDEX_BASE_FRAMES 256
+
+// Every level groups this many buckets of the level below
+#define PEAK_INDEX_LEVEL_FACTOR 4
+
+// Upper bound on the number of levels stored in one index
+#define PEAK_INDEX_MAX_LEVELS 16
+
+// Summary of one bucket of one channel
+typedef struct {
+    float min;
+    float max;
+    float rms;
+} PeakEntry;
+
+// On-disk header, followed by the levels; level l holds level_buckets[l] * channels
+// entries laid out bucket by bucket, starting level_offset[l] bytes into the file
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t channels;
+    uint32_t samplerate;
+    uint64_t frames;
+    uint64_t source_size;   // Size of the input file when the index was built
+    int64_t source_mtime_ns; // Modification time of the input file in nanoseconds when the index was built
+    uint64_t source_inode;   // Inode of the input file (outputs replaced through a rename get a new one)
+    uint32_t base_frames;
+    uint32_t level_factor;
+    uint32_t level_count;
+    uint32_t reserved;
+    uint64_t level_offset[PEAK_INDEX_MAX_LEVELS];
+    uint64_t level_buckets[PEAK_INDEX_MAX_LEVELS];
+} PeakIndexHeader;
+
+// Opened (memory-mapped where possible) index
+typedef struct {
+    const PeakIndexHeader *header;
+    void *data;
+    size_t size;
+    int mapped;
+} PeakIndex;
+
+// Function to build the sidecar index of a file in one streaming pass
+int peak_index_build(const char *input_path);
+
+// Function to open the sidecar index of a file, rebuilding it when missing or stale if build is set
+int peak_index_open(const char *input_path, PeakIndex *index, int build);
+
+// Function to release an opened index
+void peak_index_close(PeakIndex *index);
+
+// Function to get the frame count covered by one bucket of a level
+sf_count_t peak_index_bucket_frames(const PeakIndex *index, int level);
+
+// Function to get the entries of a level (bucket-major, channels entries per bucket)
+const PeakEntry *peak_index_level(const PeakIndex *index, int level);
+
+// Function to summarise frames [start_frame, end_frame) into width columns of channels entries each;
+// with a source, edges that do not fill a bucket are decoded from it so the columns are sample-exact, without one
+// the column bounds snap to the nearest finest bucket and only the index is read
+int peak_index_query(const PeakIndex *index, SNDFILE *source, sf_count_t start_frame, sf_count_t end_frame, int width,
+                     PeakEntry *columns);
+
+// Function to print the min/max/RMS overview of a time range, returns 0 on success
+int print_peaks(const char *input_path, double start_time, double end_time, int width);
+
+#endif // PEAK_INDEX_H
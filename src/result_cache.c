@@ -0,0 +1,547 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <utime.h>
+#include "result_cache.h"
+#include "audio_processing.h"
+
+#include <fcntl.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+
+// Format version mixed into every key, bumped whenever the key or the entry layout changes
+#define RESULT_CACHE_VERSION "ggsound-cache-1"
+
+// Attempts (10 ms apart) to take the stats lock, and the age in seconds after which a lock is considered abandoned
+#define STATS_LOCK_ATTEMPTS 300
+#define STATS_LOCK_STALE_SECONDS 10
+
+// 64-bit FNV-1a parameters
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+// Operations that write an output file (the rest only print)
+static const char *const cacheable_operations[] = {
+    "--cut", "--fade-in", "--fade-out", "--merge", "--channels",
+    "--normalize", "--trim-silence", "--mix", "--envelope"
+};
+
+// One stored result, as seen by eviction
+typedef struct {
+    char key[RESULT_CACHE_KEY_LENGTH + 1];
+    long long size;
+    double last_used;
+} CacheEntry;
+
+// Function to fold bytes into a 64-bit FNV-1a hash
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// Function to fold a 64-bit value into the hash
+static uint64_t hash_value(uint64_t hash, uint64_t value) {
+    unsigned char bytes[8];
+    for (int i = 0; i < 8; ++i) {
+        bytes[i] = (unsigned char)(value >> (8 * i));
+    }
+    return hash_bytes(hash, bytes, sizeof(bytes));
+}
+
+// Function to get the modification time of a file in seconds (with sub-second precision where available)
+static double file_time(const struct stat *file_stat) {
+#if defined(__linux__)
+    return (double)file_stat->st_mtim.tv_sec + file_stat->st_mtim.tv_nsec * 1e-9;
+#else
+    return (double)file_stat->st_mtime;
+#endif
+}
+
+// Function to seek to a 64-bit offset
+static int seek_to(FILE *file, long long offset) {
+#if defined(_WIN32)
+    return _fseeki64(file, offset, SEEK_SET);
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+}
+
+// Function to fold the identity of an input file into the hash: size, mtime, inode and sampled content
+static uint64_t hash_input_file(uint64_t hash, const char *path, const struct stat *file_stat) {
+    const long long size = (long long)file_stat->st_size;
+    hash = hash_value(hash, (uint64_t)size);
+    hash = hash_value(hash, (uint64_t)file_stat->st_ino);
+    hash = hash_value(hash, (uint64_t)file_stat->st_dev);
+    hash = hash_value(hash, (uint64_t)(file_time(file_stat) * 1e9));
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return hash;
+    }
+
+    // Small files are hashed whole, larger ones by their head, their tail and evenly spaced blocks between
+    unsigned char buffer[RESULT_CACHE_SAMPLE_BYTES];
+    size_t read_count;
+    if (size <= (long long)RESULT_CACHE_SAMPLE_BYTES * (RESULT_CACHE_SAMPLE_COUNT + 2)) {
+        while ((read_count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            hash = hash_bytes(hash, buffer, read_count);
+        }
+    } else {
+        const long long span = size - RESULT_CACHE_SAMPLE_BYTES;
+        for (int k = 0; k <= RESULT_CACHE_SAMPLE_COUNT + 1; ++k) {
+            if (seek_to(file, span * k / (RESULT_CACHE_SAMPLE_COUNT + 1)) != 0) {
+                break;
+            }
+            read_count = fread(buffer, 1, sizeof(buffer), file);
+            hash = hash_bytes(hash, buffer, read_count);
+        }
+    }
+
+    fclose(file);
+    return hash;
+}
+
+// Function to build the path of a file inside the cache directory
+static void cache_path(const ResultCache *cache, const char *key, const char *extension, char *path, size_t size) {
+    snprintf(path, size, "%s/%s%s", cache->dir, key, extension);
+}
+
+// Function to create a file if needed and set its modification time to now
+static void touch_file(const char *path) {
+    FILE *file = fopen(path, "ab");
+    if (file) {
+        fclose(file);
+    }
+    utime(path, NULL);
+}
+
+// Function to clone a file on copy-on-write file systems, returns 0 on success
+static int reflink_file(const char *source_path, const char *destination_path) {
+#if defined(__linux__) && defined(FICLONE)
+    int source = open(source_path, O_RDONLY);
+    if (source < 0) {
+        return -1;
+    }
+    int destination = open(destination_path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (destination < 0) {
+        close(source);
+        return -1;
+    }
+
+    int status = ioctl(destination, FICLONE, source);
+    close(source);
+    close(destination);
+    if (status != 0) {
+        remove(destination_path);
+        return -1;
+    }
+    return 0;
+#else
+    (void)source_path;
+    (void)destination_path;
+    return -1;
+#endif
+}
+
+// Function to make destination a copy of source (hard link, then reflink, then a byte copy)
+int materialize_file(const char *source_path, const char *destination_path) {
+    // The copy is made under a temporary name and renamed over the destination, which stays intact on failure
+    char temp_path[600];
+    output_temp_path(destination_path, temp_path, sizeof(temp_path));
+    remove(temp_path);
+
+#if !defined(_WIN32)
+    // Writers replace their output file instead of truncating it, so sharing the inode is safe
+    if (link(source_path, temp_path) == 0) {
+        return replace_file(temp_path, destination_path);
+    }
+#endif
+    if (reflink_file(source_path, temp_path) == 0) {
+        return replace_file(temp_path, destination_path);
+    }
+    return copy_file_raw(source_path, destination_path);
+}
+
+// Function to open (and create if needed) a cache directory
+int result_cache_open(ResultCache *cache, const char *dir, long long max_bytes) {
+    snprintf(cache->dir, sizeof(cache->dir), "%s", dir);
+    cache->max_bytes = max_bytes;
+
+#if defined(_WIN32)
+    int status = _mkdir(dir);
+#else
+    int status = mkdir(dir, 0755);
+#endif
+    struct stat dir_stat;
+    if ((status != 0 && errno != EEXIST) || stat(dir, &dir_stat) != 0 || !S_ISDIR(dir_stat.st_mode)) {
+        fprintf(stderr, "Error: Could not use %s as a cache directory\n", dir);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Function to check whether an operation writes an output file that can be cached
+int result_cache_is_cacheable(const char *operation) {
+    for (size_t i = 0; i < sizeof(cacheable_operations) / sizeof(cacheable_operations[0]); ++i) {
+        if (strcmp(operation, cacheable_operations[i]) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Function to get the output path of a command
+void result_cache_output_path(int argc, char *argv[], const char *directory, char *output_path, size_t size) {
+    snprintf(output_path, size, "%s%s", directory, "gogi.wav");
+    for (int i = 2; i + 1 < argc; ++i) {
+        if (strcmp(argv[i], "--name") == 0) {
+            snprintf(output_path, size, "%s%s", directory, argv[i + 1]);
+        }
+    }
+}
+
+// Function to hash the operation, its parameters and the identity of every input file into a key
+int result_cache_key(int argc, char *argv[], const char *directory, const char *output_path, char *key, size_t key_size) {
+    uint64_t hash = hash_bytes(FNV_OFFSET_BASIS, RESULT_CACHE_VERSION, sizeof(RESULT_CACHE_VERSION));
+
+    // The output name does not change the result, but its extension might
+    const char *extension = strrchr(output_path, '.');
+    if (extension) {
+        hash = hash_bytes(hash, extension, strlen(extension) + 1);
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--name") == 0 && i + 1 < argc) {
+            i++;
+            continue;
+        }
+        hash = hash_bytes(hash, argv[i], strlen(argv[i]) + 1);
+
+        // Any parameter naming a file is an input: audio, matrix and envelope files or mix overlays (name@offset:gain)
+        char path[256];
+        struct stat file_stat;
+        snprintf(path, sizeof(path), "%s%s", directory, argv[i]);
+        if (stat(path, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+            const char *at = strrchr(argv[i], '@');
+            if (!at) {
+                continue;
+            }
+            snprintf(path, sizeof(path), "%s%.*s", directory, (int)(at - argv[i]), argv[i]);
+            if (stat(path, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+                continue;
+            }
+        }
+
+        // A job that overwrites one of its inputs is not repeatable
+        if (strcmp(path, output_path) == 0) {
+            return 1;
+        }
+        hash = hash_input_file(hash, path, &file_stat);
+    }
+
+    snprintf(key, key_size, "%016llx", (unsigned long long)hash);
+    return 0;
+}
+
+// Function to place a stored result at output_path
+int result_cache_fetch(const ResultCache *cache, const char *key, const char *output_path) {
+    char entry_path[512];
+    char used_path[512];
+    struct stat entry_stat;
+
+    cache_path(cache, key, ".out", entry_path, sizeof(entry_path));
+    if (stat(entry_path, &entry_stat) != 0 || materialize_file(entry_path, output_path) != 0) {
+        return 0;
+    }
+
+    cache_path(cache, key, ".used", used_path, sizeof(used_path));
+    touch_file(used_path);
+    return 1;
+}
+
+// Function to store a finished output under a key
+int result_cache_store(const ResultCache *cache, const char *key, const char *output_path) {
+    char entry_path[512];
+    char used_path[512];
+
+    cache_path(cache, key, ".out", entry_path, sizeof(entry_path));
+    cache_path(cache, key, ".used", used_path, sizeof(used_path));
+
+    // Entries appear under their key only once complete (materialize_file renames a per-process temp file)
+    if (materialize_file(output_path, entry_path) != 0) {
+        fprintf(stderr, "Error: Could not store %s in the cache\n", output_path);
+        return -1;
+    }
+
+    touch_file(used_path);
+    return 0;
+}
+
+// Function to list the stored results of a cache, returns 0 on success
+static int list_entries(const ResultCache *cache, CacheEntry **entries, int *count, long long *total_bytes) {
+    *entries = NULL;
+    *count = 0;
+    *total_bytes = 0;
+
+    DIR *dir = opendir(cache->dir);
+    if (!dir) {
+        fprintf(stderr, "Error: Could not read cache directory %s\n", cache->dir);
+        return -1;
+    }
+
+    int capacity = 0;
+    struct dirent *dir_entry;
+    while ((dir_entry = readdir(dir)) != NULL) {
+        const char *name = dir_entry->d_name;
+        if (strlen(name) != RESULT_CACHE_KEY_LENGTH + 4 || strcmp(name + RESULT_CACHE_KEY_LENGTH, ".out") != 0) {
+            continue;
+        }
+
+        CacheEntry entry;
+        char path[512];
+        struct stat file_stat;
+        memcpy(entry.key, name, RESULT_CACHE_KEY_LENGTH);
+        entry.key[RESULT_CACHE_KEY_LENGTH] = '\0';
+
+        cache_path(cache, entry.key, ".out", path, sizeof(path));
+        if (stat(path, &file_stat) != 0) {
+            continue;
+        }
+        entry.size = (long long)file_stat.st_size;
+        entry.last_used = file_time(&file_stat);
+
+        cache_path(cache, entry.key, ".used", path, sizeof(path));
+        if (stat(path, &file_stat) == 0) {
+            entry.last_used = file_time(&file_stat);
+        }
+
+        if (*count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            CacheEntry *grown = (CacheEntry *)realloc(*entries, capacity * sizeof(CacheEntry));
+            if (!grown) {
+                fprintf(stderr, "Error: Could not allocate memory for cache entries.\n");
+                free(*entries);
+                *entries = NULL;
+                closedir(dir);
+                return -1;
+            }
+            *entries = grown;
+        }
+        (*entries)[(*count)++] = entry;
+        *total_bytes += entry.size;
+    }
+
+    closedir(dir);
+    return 0;
+}
+
+// Function to order entries from least to most recently used
+static int compare_last_used(const void *a, const void *b) {
+    const CacheEntry *first = (const CacheEntry *)a;
+    const CacheEntry *second = (const CacheEntry *)b;
+    if (first->last_used != second->last_used) {
+        return (first->last_used < second->last_used) ? -1 : 1;
+    }
+    return strcmp(first->key, second->key);
+}
+
+// Function to get the path of the stats file
+static void stats_path(const ResultCache *cache, char *path, size_t size) {
+    snprintf(path, size, "%s/stats", cache->dir);
+}
+
+// Function to read the counters of a cache
+void result_cache_read_stats(const ResultCache *cache, ResultCacheStats *stats) {
+    char path[512];
+    stats->hits = 0;
+    stats->misses = 0;
+    stats->evictions = 0;
+
+    stats_path(cache, path, sizeof(path));
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return;
+    }
+    if (fscanf(file, "hits %lld misses %lld evictions %lld", &stats->hits, &stats->misses, &stats->evictions) != 3) {
+        stats->hits = 0;
+        stats->misses = 0;
+        stats->evictions = 0;
+    }
+    fclose(file);
+}
+
+// Function to wait for a few milliseconds
+static void sleep_ms(int milliseconds) {
+#if defined(_WIN32)
+    Sleep(milliseconds);
+#else
+    struct timespec delay = {milliseconds / 1000, (milliseconds % 1000) * 1000000L};
+    nanosleep(&delay, NULL);
+#endif
+}
+
+// Function to take the lock that serializes stats updates between concurrent runs, returns 0 when held
+static int lock_stats(const char *lock_path) {
+    for (int attempt = 0; attempt < STATS_LOCK_ATTEMPTS; ++attempt) {
+        int lock = open(lock_path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+        if (lock >= 0) {
+            close(lock);
+            return 0;
+        }
+        if (errno != EEXIST) {
+            return -1;
+        }
+
+        // A lock left behind by a run that died is broken once it is old enough
+        struct stat lock_stat;
+        if (stat(lock_path, &lock_stat) == 0 && difftime(time(NULL), lock_stat.st_mtime) > STATS_LOCK_STALE_SECONDS) {
+            remove(lock_path);
+            continue;
+        }
+        sleep_ms(10);
+    }
+    return -1;
+}
+
+// Function to add to the counters of a cache
+static void update_stats(const ResultCache *cache, long long hits, long long misses, long long evictions) {
+    ResultCacheStats stats;
+    char path[512];
+    char lock_path[512];
+    char temp_path[512];
+
+    stats_path(cache, path, sizeof(path));
+    snprintf(lock_path, sizeof(lock_path), "%s/stats.lock", cache->dir);
+    if (lock_stats(lock_path) != 0) {
+        fprintf(stderr, "Error: Could not lock %s, cache counters not updated\n", path);
+        return;
+    }
+
+    result_cache_read_stats(cache, &stats);
+    stats.hits += hits;
+    stats.misses += misses;
+    stats.evictions += evictions;
+
+    // Readers never see a half-written file
+    output_temp_path(path, temp_path, sizeof(temp_path));
+    FILE *file = fopen(temp_path, "w");
+    if (file) {
+        fprintf(file, "hits %lld\nmisses %lld\nevictions %lld\n", stats.hits, stats.misses, stats.evictions);
+        if (fclose(file) == 0) {
+            replace_file(temp_path, path);
+        } else {
+            remove(temp_path);
+        }
+    }
+
+    remove(lock_path);
+}
+
+// Function to remove least recently used entries until the cache fits its size limit
+int result_cache_evict(const ResultCache *cache) {
+    CacheEntry *entries;
+    int count;
+    long long total_bytes;
+
+    if (list_entries(cache, &entries, &count, &total_bytes) != 0) {
+        return 0;
+    }
+
+    int evicted = 0;
+    if (total_bytes > cache->max_bytes) {
+        qsort(entries, count, sizeof(CacheEntry), compare_last_used);
+        for (int i = 0; i < count && total_bytes > cache->max_bytes; ++i) {
+            char path[512];
+            cache_path(cache, entries[i].key, ".out", path, sizeof(path));
+            if (remove(path) != 0) {
+                continue;
+            }
+            cache_path(cache, entries[i].key, ".used", path, sizeof(path));
+            remove(path);
+            total_bytes -= entries[i].size;
+            evicted++;
+        }
+    }
+
+    free(entries);
+    if (evicted > 0) {
+        update_stats(cache, 0, 0, evicted);
+    }
+    return evicted;
+}
+
+// Function to print the counters and the size of a cache
+void result_cache_print_stats(const ResultCache *cache) {
+    ResultCacheStats stats;
+    CacheEntry *entries;
+    int count;
+    long long total_bytes;
+
+    if (list_entries(cache, &entries, &count, &total_bytes) != 0) {
+        return;
+    }
+    free(entries);
+    result_cache_read_stats(cache, &stats);
+
+    const long long lookups = stats.hits + stats.misses;
+    printf("Result cache %s:\n", cache->dir);
+    printf("    Hits: %lld\n", stats.hits);
+    printf("    Misses: %lld\n", stats.misses);
+    printf("    Hit rate: %.1f%%\n", lookups > 0 ? 100.0 * stats.hits / lookups : 0.0);
+    printf("    Evictions: %lld\n", stats.evictions);
+    printf("    Entries: %d (%.1f MB of %.1f MB)\n", count, total_bytes / 1048576.0, cache->max_bytes / 1048576.0);
+}
+
+// Function to run a command through the cache
+int result_cache_run(const ResultCache *cache, int argc, char *argv[], const char *directory, CachedCommand command) {
+    char output_path[256];
+    char key[RESULT_CACHE_KEY_LENGTH + 1];
+
+    if (argc < 2 || !result_cache_is_cacheable(argv[1])) {
+        return command(argc, argv);
+    }
+
+    result_cache_output_path(argc, argv, directory, output_path, sizeof(output_path));
+    if (result_cache_key(argc, argv, directory, output_path, key, sizeof(key)) != 0) {
+        return command(argc, argv);
+    }
+
+    if (result_cache_fetch(cache, key, output_path)) {
+        update_stats(cache, 1, 0, 0);
+        printf("Cache hit %s: result restored to %s\n", key, output_path);
+        return 0;
+    }
+    update_stats(cache, 0, 1, 0);
+
+    // Writers only replace the output once they succeed, so a failed job leaves nothing to store
+    int status = command(argc, argv);
+    struct stat output_stat;
+    if (status == 0 && stat(output_path, &output_stat) == 0 && result_cache_store(cache, key, output_path) == 0) {
+        printf("Cache miss %s: result stored\n", key);
+        result_cache_evict(cache);
+    }
+
+    return status;
+}
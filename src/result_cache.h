@@ -0,0 +1,71 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <stddef.h>
+
+// Default size limit of the cache directory in megabytes
+#define RESULT_CACHE_DEFAULT_MAX_MB 1024
+
+// Bytes hashed from the head, the tail and each sampled block of an input file
+#define RESULT_CACHE_SAMPLE_BYTES 4096
+
+// Number of evenly spaced blocks hashed from an input file
+#define RESULT_CACHE_SAMPLE_COUNT 16
+
+// Length of a cache key in hex digits
+#define RESULT_CACHE_KEY_LENGTH 16
+
+// Content-addressed store of finished results: <dir>/<key>.out holds the output of a job,
+// <dir>/<key>.used is touched on every hit (least recently used entries are evicted first)
+// and <dir>/stats keeps the hit, miss and eviction counters.
+typedef struct {
+    char dir[256];
+    long long max_bytes;
+} ResultCache;
+
+// Counters kept in the stats file of a cache
+typedef struct {
+    long long hits;
+    long long misses;
+    long long evictions;
+} ResultCacheStats;
+
+// Command run on a cache miss, same calling convention as main
+typedef int (*CachedCommand)(int argc, char *argv[]);
+
+// Function to open (and create if needed) a cache directory, returns 0 on success
+int result_cache_open(ResultCache *cache, const char *dir, long long max_bytes);
+
+// Function to check whether an operation writes an output file that can be cached
+int result_cache_is_cacheable(const char *operation);
+
+// Function to get the output path of a command ("--name <output name>" or the default gogi.wav)
+void result_cache_output_path(int argc, char *argv[], const char *directory, char *output_path, size_t size);
+
+// Function to hash the operation, its parameters and the identity of every input file into a key,
+// returns 0 on success and 1 when the job cannot be cached (e.g. it writes over one of its inputs)
+int result_cache_key(int argc, char *argv[], const char *directory, const char *output_path, char *key, size_t key_size);
+
+// Function to place a stored result at output_path, returns 1 on a hit and 0 on a miss
+int result_cache_fetch(const ResultCache *cache, const char *key, const char *output_path);
+
+// Function to store a finished output under a key, returns 0 on success
+int result_cache_store(const ResultCache *cache, const char *key, const char *output_path);
+
+// Function to remove least recently used entries until the cache fits its size limit, returns the number removed
+int result_cache_evict(const ResultCache *cache);
+
+// Function to read the counters of a cache
+void result_cache_read_stats(const ResultCache *cache, ResultCacheStats *stats);
+
+// Function to print the counters and the size of a cache
+void result_cache_print_stats(const ResultCache *cache);
+
+// Function to run a command through the cache: identical jobs are answered from the store
+int result_cache_run(const ResultCache *cache, int argc, char *argv[], const char *directory, CachedCommand command);
+
+// Function to make destination a copy of source (hard link, then reflink, then a byte copy) by renaming a temporary
+// copy over it, so a failure leaves the previous destination in place; returns 0 on success
+int materialize_file(const char *source_path, const char *destination_path);
+
+#endif // RESULT_CACHE_H
@@ -0,0 +1,372 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <sndfile.h>
+#include "silence.h"
+#include "peak_index.h"
+#include "audio_processing.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Number of frames read per step while scanning
+#define SILENCE_CHUNK_FRAMES 4096
+
+// Function to find the first sample whose magnitude exceeds the threshold
+sf_count_t find_first_above(const float *samples, sf_count_t count, float threshold) {
+    sf_count_t i = 0;
+
+#if defined(__SSE2__)
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 limit = _mm_set1_ps(threshold);
+    for (; i + 4 <= count; i += 4) {
+        int mask = _mm_movemask_ps(_mm_cmpgt_ps(_mm_and_ps(_mm_loadu_ps(samples + i), abs_mask), limit));
+        if (mask) {
+            for (int j = 0; j < 4; ++j) {
+                if (mask & (1 << j)) return i + j;
+            }
+        }
+    }
+#endif
+
+    for (; i < count; ++i) {
+        if (fabsf(samples[i]) > threshold) return i;
+    }
+    return -1;
+}
+
+// Function to find the last sample whose magnitude exceeds the threshold
+sf_count_t find_last_above(const float *samples, sf_count_t count, float threshold) {
+    sf_count_t i = count;
+
+    // Peel the ragged end first so the vector loop walks whole groups of four backwards
+    while (i % 4 != 0) {
+        --i;
+        if (fabsf(samples[i]) > threshold) return i;
+    }
+
+#if defined(__SSE2__)
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 limit = _mm_set1_ps(threshold);
+    while (i >= 4) {
+        i -= 4;
+        int mask = _mm_movemask_ps(_mm_cmpgt_ps(_mm_and_ps(_mm_loadu_ps(samples + i), abs_mask), limit));
+        if (mask) {
+            for (int j = 3; j >= 0; --j) {
+                if (mask & (1 << j)) return i + j;
+            }
+        }
+    }
+#else
+    while (i > 0) {
+        --i;
+        if (fabsf(samples[i]) > threshold) return i;
+    }
+#endif
+
+    return -1;
+}
+
+// Function to check whether every channel of an index bucket stays within the threshold
+static int bucket_is_quiet(const PeakEntry *entries, int channels, sf_count_t bucket, float threshold) {
+    for (int ch = 0; ch < channels; ++ch) {
+        const PeakEntry *entry = &entries[bucket * channels + ch];
+        if (entry->max > threshold || -entry->min > threshold) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Function to locate the audible part of a file by scanning only its edges (1 if the file is silent)
+int find_audio_bounds(const char *input_path, float threshold, sf_count_t *first_frame, sf_count_t *end_frame) {
+    SF_INFO sf_info = {0};
+
+    SNDFILE *input_file = sf_open(input_path, SFM_READ, &sf_info);
+    if (!input_file) {
+        fprintf(stderr, "Error: Could not open input file %s\n", input_path);
+        return -1;
+    }
+
+    const int channels = sf_info.channels;
+    sf_count_t forward_start = 0;
+    sf_count_t backward_end = sf_info.frames;
+
+    // A fresh peak index lets both scans jump over buckets that are known to be quiet
+    PeakIndex index;
+    if (peak_index_open(input_path, &index, 0) == 0) {
+        if ((int)index.header->channels == channels && (sf_count_t)index.header->frames == sf_info.frames) {
+            const PeakEntry *entries = peak_index_level(&index, 0);
+            const sf_count_t buckets = (sf_count_t)index.header->level_buckets[0];
+            sf_count_t bucket = 0;
+            while (bucket < buckets && bucket_is_quiet(entries, channels, bucket, threshold)) bucket++;
+            forward_start = bucket * PEAK_INDEX_BASE_FRAMES;
+
+            bucket = buckets - 1;
+            while (bucket >= 0 && bucket_is_quiet(entries, channels, bucket, threshold)) bucket--;
+            backward_end = (bucket + 1) * PEAK_INDEX_BASE_FRAMES;
+        }
+        peak_index_close(&index);
+    }
+    if (forward_start > sf_info.frames) forward_start = sf_info.frames;
+    if (backward_end > sf_info.frames) backward_end = sf_info.frames;
+
+    float *buffer = (float *)malloc((size_t)SILENCE_CHUNK_FRAMES * channels * sizeof(float));
+    if (!buffer) {
+        fprintf(stderr, "Error: Could not allocate memory for buffer.\n");
+        sf_close(input_file);
+        return -1;
+    }
+
+    // Forward scan from the start until the first audible sample
+    sf_count_t first = -1;
+    sf_count_t position = forward_start;
+    if (position < backward_end && sf_seek(input_file, position, SEEK_SET) >= 0) {
+        sf_count_t read_frames;
+        while (position < backward_end && (read_frames = sf_readf_float(input_file, buffer, SILENCE_CHUNK_FRAMES)) > 0) {
+            sf_count_t found = find_first_above(buffer, read_frames * channels, threshold);
+            if (found >= 0) {
+                first = position + found / channels;
+                break;
+            }
+            position += read_frames;
+        }
+    }
+
+    if (first < 0) {
+        free(buffer);
+        sf_close(input_file);
+        *first_frame = *end_frame = sf_info.frames;
+        return 1;
+    }
+
+    // Backward scan from the end until the last audible sample
+    sf_count_t last = first;
+    position = backward_end;
+    while (position > first) {
+        sf_count_t chunk_start = (position - SILENCE_CHUNK_FRAMES > first) ? position - SILENCE_CHUNK_FRAMES : first;
+        if (sf_seek(input_file, chunk_start, SEEK_SET) < 0) {
+            break;
+        }
+        sf_count_t read_frames = sf_readf_float(input_file, buffer, position - chunk_start);
+        if (read_frames <= 0) {
+            break;
+        }
+        sf_count_t found = find_last_above(buffer, read_frames * channels, threshold);
+        if (found >= 0) {
+            last = chunk_start + found / channels;
+            break;
+        }
+        position = chunk_start;
+    }
+
+    // Clean up
+    free(buffer);
+    sf_close(input_file);
+
+    *first_frame = first;
+    *end_frame = last + 1;
+    return 0;
+}
+
+// Function to trim leading and trailing silence longer than min_ms
+int trim_silence(const char *input_path, const char *output_path, double threshold_db, double min_ms) {
+    SF_INFO sf_info = {0};
+
+    SNDFILE *input_file = sf_open(input_path, SFM_READ, &sf_info);
+    if (!input_file) {
+        fprintf(stderr, "Error: Could not open input file %s\n", input_path);
+        return -1;
+    }
+    sf_close(input_file);
+
+    const float threshold = (float)pow(10.0, threshold_db / 20.0);
+    const sf_count_t min_frames = (sf_count_t)(min_ms / 1000.0 * sf_info.samplerate + 0.5);
+
+    sf_count_t first_frame, end_frame;
+    int status = find_audio_bounds(input_path, threshold, &first_frame, &end_frame);
+    if (status < 0) {
+        return -1;
+    }
+    if (status > 0) {
+        fprintf(stderr, "Error: %s is entirely below %.1f dB, nothing would be left after trimming\n", input_path, threshold_db);
+        return -1;
+    }
+
+    // Silence shorter than min_ms at either edge is kept
+    if (first_frame < min_frames) first_frame = 0;
+    if (sf_info.frames - end_frame < min_frames) end_frame = sf_info.frames;
+
+    // Nothing to trim: the file bytes are copied as they are
+    if (first_frame == 0 && end_frame == sf_info.frames) {
+        status = copy_file_raw(input_path, output_path);
+    } else {
+        status = extract_wav_frames(input_path, output_path, first_frame, end_frame);
+    }
+    if (status != 0) {
+        return -1;
+    }
+
+    printf("Trimmed %.3f seconds of leading and %.3f seconds of trailing silence from %s and saved to %s\n",
+           (double)first_frame / sf_info.samplerate, (double)(sf_info.frames - end_frame) / sf_info.samplerate,
+           input_path, output_path);
+
+    return 0;
+}
+
+// Running state of the silent span search
+typedef struct {
+    int channels;
+    int samplerate;
+    float threshold;
+    sf_count_t min_frames;
+    int in_silence;
+    sf_count_t silence_start;
+    int span_count;
+} SilenceScan;
+
+// Function to print a silent span when it is long enough
+static void report_span(SilenceScan *scan, sf_count_t end) {
+    if (end - scan->silence_start >= scan->min_frames && end > scan->silence_start) {
+        printf("    [%.3f:%.3f]\n", (double)scan->silence_start / scan->samplerate, (double)end / scan->samplerate);
+        scan->span_count++;
+    }
+}
+
+// Function to feed decoded frames starting at position into the span search
+static void scan_frames(SilenceScan *scan, const float *buffer, sf_count_t frames, sf_count_t position) {
+    const int channels = scan->channels;
+    sf_count_t i = 0;
+
+    while (i < frames) {
+        if (scan->in_silence) {
+            // Vector search for the end of the silence
+            sf_count_t found = find_first_above(buffer + i * channels, (frames - i) * channels, scan->threshold);
+            if (found < 0) {
+                return;
+            }
+            i += found / channels;
+            report_span(scan, position + i);
+            scan->in_silence = 0;
+            i++;
+        } else {
+            // A frame starts a silence once every channel is within the threshold
+            int quiet = 1;
+            for (int ch = 0; ch < channels; ++ch) {
+                if (fabsf(buffer[i * channels + ch]) > scan->threshold) {
+                    quiet = 0;
+                    break;
+                }
+            }
+            if (quiet) {
+                scan->in_silence = 1;
+                scan->silence_start = position + i;
+            }
+            i++;
+        }
+    }
+}
+
+// Function to print every silent span longer than min_ms
+int detect_silence(const char *input_path, double threshold_db, double min_ms) {
+    SF_INFO sf_info = {0};
+
+    SNDFILE *input_file = sf_open(input_path, SFM_READ, &sf_info);
+    if (!input_file) {
+        fprintf(stderr, "Error: Could not open input file %s\n", input_path);
+        return -1;
+    }
+
+    SilenceScan scan = {0};
+    scan.channels = sf_info.channels;
+    scan.samplerate = sf_info.samplerate;
+    scan.threshold = (float)pow(10.0, threshold_db / 20.0);
+    scan.min_frames = (sf_count_t)(min_ms / 1000.0 * sf_info.samplerate + 0.5);
+    scan.in_silence = 1;
+    scan.silence_start = 0;
+
+    float *buffer = (float *)malloc((size_t)SILENCE_CHUNK_FRAMES * sf_info.channels * sizeof(float));
+    if (!buffer) {
+        fprintf(stderr, "Error: Could not allocate memory for buffer.\n");
+        sf_close(input_file);
+        return -1;
+    }
+
+    printf("Silent spans of %s (below %.1f dB, at least %.0f ms):\n", input_path, threshold_db, min_ms);
+
+    // With a fresh index only buckets that may contain audio are decoded
+    PeakIndex index;
+    const PeakEntry *entries = NULL;
+    sf_count_t buckets = 0;
+    if (peak_index_open(input_path, &index, 0) == 0) {
+        if ((int)index.header->channels == sf_info.channels && (sf_count_t)index.header->frames == sf_info.frames) {
+            entries = peak_index_level(&index, 0);
+            buckets = (sf_count_t)index.header->level_buckets[0];
+        } else {
+            peak_index_close(&index);
+        }
+    }
+
+    sf_count_t bucket = 0;
+    int status = 0;
+    while (1) {
+        sf_count_t run_start, run_end;
+        if (entries) {
+            // Quiet buckets extend the silence without decoding
+            while (bucket < buckets && bucket_is_quiet(entries, sf_info.channels, bucket, scan.threshold)) {
+                if (!scan.in_silence) {
+                    scan.in_silence = 1;
+                    scan.silence_start = bucket * PEAK_INDEX_BASE_FRAMES;
+                }
+                bucket++;
+            }
+            if (bucket >= buckets) {
+                break;
+            }
+            run_start = bucket * PEAK_INDEX_BASE_FRAMES;
+            while (bucket < buckets && !bucket_is_quiet(entries, sf_info.channels, bucket, scan.threshold)) bucket++;
+            run_end = bucket * PEAK_INDEX_BASE_FRAMES;
+        } else {
+            run_start = 0;
+            run_end = sf_info.frames;
+        }
+        if (run_end > sf_info.frames) run_end = sf_info.frames;
+
+        // Decode the run that may contain audio
+        sf_count_t position = run_start;
+        if (sf_seek(input_file, position, SEEK_SET) < 0) {
+            fprintf(stderr, "Error: Could not seek in input file %s\n", input_path);
+            status = -1;
+            break;
+        }
+        while (position < run_end) {
+            sf_count_t wanted = (run_end - position < SILENCE_CHUNK_FRAMES) ? run_end - position : SILENCE_CHUNK_FRAMES;
+            sf_count_t read_frames = sf_readf_float(input_file, buffer, wanted);
+            if (read_frames <= 0) {
+                break;
+            }
+            scan_frames(&scan, buffer, read_frames, position);
+            position += read_frames;
+        }
+
+        if (!entries) {
+            break;
+        }
+    }
+
+    if (status == 0) {
+        if (scan.in_silence) {
+            report_span(&scan, sf_info.frames);
+        }
+        printf("%d silent spans found\n", scan.span_count);
+    }
+
+    // Clean up
+    if (entries) {
+        peak_index_close(&index);
+    }
+    free(buffer);
+    sf_close(input_file);
+    return status;
+}
@@ -0,0 +1,21 @@
+#ifndef SILENCE_H
+#define SILENCE_H
+
+#include <sndfile.h>
+
+// Function to find the first sample whose magnitude exceeds the threshold, -1 if none
+sf_count_t find_first_above(const float *samples, sf_count_t count, float threshold);
+
+// Function to find the last sample whose magnitude exceeds the threshold, -1 if none
+sf_count_t find_last_above(const float *samples, sf_count_t count, float threshold);
+
+// Function to locate the audible part [first_frame, end_frame) of a file by scanning only its edges
+int find_audio_bounds(const char *input_path, float threshold, sf_count_t *first_frame, sf_count_t *end_frame);
+
+// Function to trim leading and trailing silence longer than min_ms
+int trim_silence(const char *input_path, const char *output_path, double threshold_db, double min_ms);
+
+// Function to print every silent span longer than min_ms, returns 0 on success
+int detect_silence(const char *input_path, double threshold_db, double min_ms);
+
+#endif // SILENCE_H
@@ -1,22 +1,40 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sndfile.h>
 #include <assert.h>
+#include <math.h>
+#include "../src/channel_matrix.h"
+#include "../src/audio_block.h"
+#include "../src/analysis.h"
+#include "../src/peak_index.h"
+#include "../src/silence.h"
+#include "../src/mix.h"
+#include "../src/envelope.h"
+#include "../src/result_cache.h"
 
 // Function to get the length of an audio file in seconds
 double get_audio_length(const char *filepath);
 
 // Function to trim audio file
-void cut_wav_segment(const char *input_path, const char *output_path, double start_time, double end_time);
+int cut_wav_segment(const char *input_path, const char *output_path, double start_time, double end_time);
 
 // Function to add fade-in
-void add_fade_in(const char *input_path, const char *output_path, double fading_time);
+int add_fade_in(const char *input_path, const char *output_path, double fading_time);
 
 // Function to add fade-out
-void add_fade_out(const char *input_path, const char *output_path, double fading_time);
+int add_fade_out(const char *input_path, const char *output_path, double fading_time);
 
 // Function to merge audio file
-void merge_wav_files(const char *input1_path, const char *input2_path, const char *output_path);
+int merge_wav_files(const char *input1_path, const char *input2_path, const char *output_path);
+
+// Function to merge audio files into a given channel count (0 keeps the layout of the first file)
+int merge_wav_files_to_channels(const char *input1_path, const char *input2_path, const char *output_path, int out_channels);
+int merge_wav_files_remapped(const char *input1_path, const char *input2_path, const char *output_path, int out_channels,
+                             const char *matrix_path);
+
+// Function to copy frames [start_frame, end_frame) of a file into a new file
+int extract_wav_frames(const char *input_path, const char *output_path, sf_count_t start_frame, sf_count_t end_frame);
 
 void test_cut_wav_segment_normal_case() {
     const char *input_path = "audio/song1.wav";
@@ -191,15 +209,699 @@ void test_merge_wav_files() {
 
     input2_path = "audio/song2.wav";
 
-    merge_wav_files(input1_path, input2_path, output_path);
+    assert(merge_wav_files(input1_path, input2_path, output_path) != 0);
 
     // Verify that the output file was not created
     output_file = sf_open(output_path, SFM_READ, NULL);
     assert(output_file == NULL); // Should be NULL since the input file doesn't exist
 
     printf("----Merging test passed for incompatible files.\n");
+
+    // A missing second file fails without leaving a partial output behind
+    remove(output_path);
+    assert(merge_wav_files(input1_path, "audio/non_existent_file.wav", output_path) != 0);
+    assert(get_audio_length(output_path) < 0);
+
+    printf("----Merging test passed for a missing file.\n");
+}
+
+void test_channel_matrix_kernels() {
+    // 9 frames so that every kernel runs both its vector body and the scalar tail
+    float stereo[18];
+    float mono[9];
+    float surround[54];
+    float output[18];
+    for (int i = 0; i < 9; ++i) {
+        stereo[2 * i] = (float)i;
+        stereo[2 * i + 1] = (float)(i + 1);
+        mono[i] = (float)i;
+        for (int ch = 0; ch < 6; ++ch) {
+            surround[6 * i + ch] = (float)(ch + 1 + 10 * i); // Distinct per frame so a transposition slip shows
+        }
+    }
+
+    ChannelMatrix matrix;
+
+    assert(channel_matrix_init_default(&matrix, 2, 1) == 0);
+    channel_matrix_apply(&matrix, stereo, output, 9);
+    for (int i = 0; i < 9; ++i) {
+        assert(fabsf(output[i] - ((float)i + 0.5f)) < 1e-6f);
+    }
+    channel_matrix_free(&matrix);
+
+    assert(channel_matrix_init_default(&matrix, 1, 2) == 0);
+    channel_matrix_apply(&matrix, mono, output, 9);
+    for (int i = 0; i < 9; ++i) {
+        assert(output[2 * i] == (float)i && output[2 * i + 1] == (float)i);
+    }
+    channel_matrix_free(&matrix);
+
+    // L = (L + 0.707 * C + 0.707 * Ls) / 2.414, R = (R + 0.707 * C + 0.707 * Rs) / 2.414
+    assert(channel_matrix_init_default(&matrix, 6, 2) == 0);
+    channel_matrix_apply(&matrix, surround, output, 9);
+    const float k = 0.70710678f;
+    for (int i = 0; i < 9; ++i) {
+        const float *frame = surround + 6 * i;
+        assert(fabsf(output[2 * i] - (frame[0] + k * frame[2] + k * frame[4]) / (1.0f + 2.0f * k)) < 1e-4f);
+        assert(fabsf(output[2 * i + 1] - (frame[1] + k * frame[2] + k * frame[5]) / (1.0f + 2.0f * k)) < 1e-4f);
+    }
+    channel_matrix_free(&matrix);
+
+    // Every weight distinct, so each channel has to land in its own place
+    float weights[12];
+    for (int j = 0; j < 12; ++j) {
+        weights[j] = (float)(j + 1) * 0.01f;
+    }
+    ChannelMatrix custom = {6, 2, weights};
+    channel_matrix_apply(&custom, surround, output, 9);
+    for (int i = 0; i < 9; ++i) {
+        for (int out = 0; out < 2; ++out) {
+            float expected = 0.0f;
+            for (int ch = 0; ch < 6; ++ch) {
+                expected += weights[out * 6 + ch] * surround[6 * i + ch];
+            }
+            assert(fabsf(output[2 * i + out] - expected) < 1e-4f);
+        }
+    }
+
+    // Default layouts never route a channel somewhere it does not belong
+    assert(channel_matrix_init_default(&matrix, 2, 6) == 0);
+    for (int out = 0; out < 6; ++out) {
+        for (int in = 0; in < 2; ++in) {
+            assert(matrix.coeffs[out * 2 + in] == ((out == in) ? 1.0f : 0.0f)); // L, R kept; C, LFE, Ls, Rs silent
+        }
+    }
+    channel_matrix_free(&matrix);
+
+    assert(channel_matrix_init_default(&matrix, 6, 1) == 0);
+    assert(matrix.coeffs[3] == 0.0f); // No LFE in the mono fold-down
+    assert(fabsf(matrix.coeffs[0] - matrix.coeffs[1]) < 1e-7f && matrix.coeffs[2] > 0.0f);
+    channel_matrix_free(&matrix);
+
+    assert(channel_matrix_init_default(&matrix, 1, 6) == 0);
+    for (int out = 0; out < 6; ++out) {
+        assert(matrix.coeffs[out] == ((out == 2) ? 1.0f : 0.0f)); // Centre only
+    }
+    channel_matrix_free(&matrix);
+
+    assert(channel_matrix_init_default(&matrix, 6, 4) != 0); // Needs a matrix file
+
+    printf("----Channel matrix kernel test passed.\n");
+}
+
+void test_remap_channels() {
+    const char *input_path = "audio/song1.wav";
+    const char *mono_path = "audio/test_mono.wav";
+    const char *output_path = "audio/test.wav";
+
+    // Fold the stereo file down to mono
+    assert(remap_channels(input_path, mono_path, 1, NULL) == 0);
+
+    SF_INFO sf_info;
+    SNDFILE *output_file = sf_open(mono_path, SFM_READ, &sf_info);
+    assert(output_file != NULL); // Ensure file opened successfully
+    assert(sf_info.channels == 1);
+    assert(get_audio_length(mono_path) == get_audio_length(input_path));
+    sf_close(output_file);
+
+    printf("----Channel remapping test passed.\n");
+
+    // Mono + stereo merge with an explicit count upmixes the first file to stereo
+    assert(merge_wav_files_to_channels(mono_path, "audio/song3.wav", output_path, 2) == 0);
+
+    output_file = sf_open(output_path, SFM_READ, &sf_info);
+    assert(output_file != NULL); // Ensure file opened successfully
+    assert(sf_info.channels == 2);
+    sf_close(output_file);
+
+    // Without a count the merge keeps the layout of the first file and folds the second one down
+    assert(merge_wav_files_to_channels(mono_path, "audio/song3.wav", output_path, 0) == 0);
+
+    output_file = sf_open(output_path, SFM_READ, &sf_info);
+    assert(output_file != NULL);
+    assert(sf_info.channels == 1);
+    assert(fabs(get_audio_length(output_path) - get_audio_length(mono_path) - get_audio_length("audio/song3.wav")) < 1e-3);
+    sf_close(output_file);
+
+    // A matrix file remaps the second file into the layout of the first
+    const char *matrix_path = "audio/test_merge_matrix.txt";
+    FILE *matrix_file = fopen(matrix_path, "w");
+    assert(matrix_file != NULL);
+    fprintf(matrix_file, "0.5\n0.25\n");
+    fclose(matrix_file);
+    assert(merge_wav_files_remapped(input_path, mono_path, output_path, 0, matrix_path) == 0);
+
+    SF_INFO mono_info;
+    SNDFILE *mono_file = sf_open(mono_path, SFM_READ, &mono_info);
+    assert(mono_file != NULL);
+    float mono[256];
+    sf_count_t mono_frames = sf_readf_float(mono_file, mono, 256);
+    sf_close(mono_file);
+
+    output_file = sf_open(output_path, SFM_READ, &sf_info);
+    assert(output_file != NULL);
+    assert(sf_info.channels == 2);
+    float merged[512];
+    sf_seek(output_file, sf_info.frames - mono_info.frames, SEEK_SET);
+    assert(sf_readf_float(output_file, merged, mono_frames) == mono_frames);
+    sf_close(output_file);
+    for (sf_count_t i = 0; i < mono_frames; ++i) {
+        assert(fabsf(merged[2 * i] - 0.5f * mono[i]) < 1e-3f);
+        assert(fabsf(merged[2 * i + 1] - 0.25f * mono[i]) < 1e-3f);
+    }
+
+    // A matrix whose rows do not match the first file is rejected
+    matrix_file = fopen(matrix_path, "w");
+    assert(matrix_file != NULL);
+    fprintf(matrix_file, "1\n1\n1\n");
+    fclose(matrix_file);
+    assert(merge_wav_files_remapped(input_path, mono_path, output_path, 0, matrix_path) != 0);
+
+    remove(matrix_path);
+    remove(mono_path);
+    printf("----Merging test passed for different channel counts.\n");
+}
+
+
+void test_audio_block_roundtrip() {
+    // Odd sizes exercise the vector bodies, the 4x4 transposes, the tails and the lane padding
+    const int channel_counts[] = {1, 2, 4, 5, 33, 64};
+    const sf_count_t frames = 137;
+
+    for (int c = 0; c < 6; ++c) {
+        const int channels = channel_counts[c];
+        float *interleaved = malloc(frames * channels * sizeof(float));
+        float *restored = malloc(frames * channels * sizeof(float));
+        assert(interleaved != NULL && restored != NULL);
+        for (sf_count_t i = 0; i < frames * channels; ++i) {
+            interleaved[i] = (float)i;
+        }
+
+        AudioBlock block;
+        assert(audio_block_init(&block, channels, 160) == 0);
+        audio_block_deinterleave(&block, interleaved, frames);
+        for (int ch = 0; ch < channels; ++ch) {
+            assert(((size_t)block.lanes[ch] % AUDIO_BLOCK_ALIGNMENT) == 0);
+            for (sf_count_t i = 0; i < frames; ++i) {
+                assert(block.lanes[ch][i] == interleaved[i * channels + ch]);
+            }
+        }
+
+        // Ramp over the middle of the block leaves the edges untouched
+        audio_block_apply_ramp(&block, 10, 20, 0.0f, 0.5f);
+        audio_block_interleave(&block, restored);
+        for (sf_count_t i = 0; i < frames; ++i) {
+            float gain = (i >= 10 && i < 30) ? 0.5f * (float)(i - 10) : 1.0f;
+            for (int ch = 0; ch < channels; ++ch) {
+                assert(restored[i * channels + ch] == interleaved[i * channels + ch] * gain);
+            }
+        }
+
+        audio_block_free(&block);
+        free(interleaved);
+        free(restored);
+    }
+
+    printf("----Planar block round-trip test passed.\n");
 }
 
+// Function to write a sine test file with the given amplitude in every channel
+void write_test_tone(const char *path, int channels, int samplerate, double seconds, double amplitude, double frequency) {
+    SF_INFO sf_info = {0};
+    sf_info.channels = channels;
+    sf_info.samplerate = samplerate;
+    sf_info.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+
+    SNDFILE *file = sf_open(path, SFM_WRITE, &sf_info);
+    assert(file != NULL);
+
+    const sf_count_t frames = (sf_count_t)(seconds * samplerate);
+    float *frame = malloc(channels * sizeof(float));
+    assert(frame != NULL);
+    for (sf_count_t i = 0; i < frames; ++i) {
+        float value = (float)(amplitude * sin(2.0 * 3.14159265358979323846 * frequency * i / samplerate));
+        for (int ch = 0; ch < channels; ++ch) {
+            frame[ch] = value;
+        }
+        sf_writef_float(file, frame, 1);
+    }
+
+    free(frame);
+    sf_close(file);
+}
+
+void test_fade_in_place() {
+    const char *path = "audio/test_in_place.wav";
+    const sf_count_t frames = 16000;
+
+    // Output name equal to the input: the file is only replaced once the new one is complete
+    write_test_tone(path, 1, 8000, 2.0, 0.5, 100.0);
+    add_fade_in(path, path, 1.0);
+
+    SF_INFO sf_info = {0};
+    SNDFILE *file = sf_open(path, SFM_READ, &sf_info);
+    assert(file != NULL && sf_info.frames == frames);
+    float *samples = malloc(frames * sizeof(float));
+    assert(samples != NULL);
+    assert(sf_readf_float(file, samples, frames) == frames);
+    sf_close(file);
+
+    for (sf_count_t i = 0; i < frames; ++i) {
+        const float expected = (float)(0.5 * sin(2.0 * 3.14159265358979323846 * 100.0 * i / 8000));
+        const float gain = (i < 8000) ? (float)i / 8000.0f : 1.0f;
+        assert(fabsf(samples[i] - expected * gain) < 1e-4f);
+    }
+
+    free(samples);
+    remove(path);
+    printf("----In-place fade test passed.\n");
+}
+
+void test_analyze_and_normalize() {
+    const char *input_path = "audio/test_tone.wav";
+    const char *output_path = "audio/test.wav";
+
+    // A stereo 1 kHz sine with 0.1 peak measures -20 dBFS peak, -23 dBFS RMS and -20 LUFS
+    write_test_tone(input_path, 2, 48000, 3.0, 0.1, 1000.0);
+
+    AudioAnalysis analysis;
+    assert(analyze_audio_file(input_path, &analysis) == 0);
+    assert(analysis.channels == 2);
+    for (int ch = 0; ch < 2; ++ch) {
+        assert(fabs(analysis.peak[ch] - 0.1) < 1e-3);
+        assert(fabs(analysis.rms[ch] - 0.1 / sqrt(2.0)) < 1e-3);
+        assert(fabs(analysis.dc_offset[ch]) < 1e-4);
+        assert(analysis.clip_count[ch] == 0);
+    }
+    assert(fabs(analysis.integrated_loudness + 20.0) < 0.2);
+    audio_analysis_free(&analysis);
+
+    // A missing input reports failure to the caller
+    assert(analyze_audio(input_path) == 0);
+    assert(analyze_audio("audio/missing.wav") != 0);
+
+    printf("----Analysis test passed.\n");
+
+    // Loudness normalization lands on the target
+    normalize_audio(input_path, output_path, -23.0, NORMALIZE_LOUDNESS);
+    assert(analyze_audio_file(output_path, &analysis) == 0);
+    assert(fabs(analysis.integrated_loudness + 23.0) < 0.1);
+    audio_analysis_free(&analysis);
+
+    // Peak normalization lands on the target
+    normalize_audio(input_path, output_path, -1.0, NORMALIZE_PEAK);
+    assert(analyze_audio_file(output_path, &analysis) == 0);
+    assert(fabs(20.0 * log10(analysis.peak[0]) + 1.0) < 0.01);
+    audio_analysis_free(&analysis);
+
+    printf("----Normalization test passed.\n");
+}
+
+void test_peak_index() {
+    const char *input_path = "audio/test_tone.wav";
+
+    // 3 seconds of a 0.5 sine, built into an index on first open
+    write_test_tone(input_path, 2, 8000, 3.0, 0.5, 100.0);
+    remove("audio/test_tone.wav.ggpk");
+
+    PeakIndex index;
+    assert(peak_index_open(input_path, &index, 1) == 0);
+    assert(index.header->channels == 2);
+    assert(index.header->frames == 24000);
+
+    // The whole file in 3 columns: every column holds full sine periods
+    PeakEntry columns[3 * 2];
+    assert(peak_index_query(&index, NULL, 0, 24000, 3, columns) == 0);
+    for (int column = 0; column < 3; ++column) {
+        assert(fabsf(columns[column * 2].max - 0.5f) < 1e-3f);
+        assert(fabsf(columns[column * 2].min + 0.5f) < 1e-3f);
+        assert(fabsf(columns[column * 2].rms - 0.5f / sqrtf(2.0f)) < 1e-2f);
+    }
+    peak_index_close(&index);
+
+    // The sidecar is reused as long as the input is unchanged
+    assert(peak_index_open(input_path, &index, 0) == 0);
+
+    // A rebuild replaces the sidecar by rename, an index that is already open keeps its data
+    assert(peak_index_build(input_path) == 0);
+    assert(index.header->frames == 24000);
+    assert(peak_index_query(&index, NULL, 0, 24000, 3, columns) == 0);
+    assert(fabsf(columns[0].max - 0.5f) < 1e-3f);
+    peak_index_close(&index);
+
+    // Tone for 1 s, then silence: ranges inside the silence must not pick up the neighbouring buckets
+    SF_INFO sf_info = {0};
+    sf_info.channels = 1;
+    sf_info.samplerate = 8000;
+    sf_info.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+    SNDFILE *file = sf_open(input_path, SFM_WRITE, &sf_info);
+    assert(file != NULL);
+    for (int i = 0; i < 24000; ++i) {
+        float sample = (i < 8000) ? ((i % 2) ? 0.5f : -0.5f) : 0.0f;
+        sf_writef_float(file, &sample, 1);
+    }
+    sf_close(file);
+    remove("audio/test_tone.wav.ggpk");
+
+    assert(peak_index_open(input_path, &index, 1) == 0);
+    file = sf_open(input_path, SFM_READ, &sf_info);
+    assert(file != NULL);
+
+    PeakEntry silent[2];
+    assert(peak_index_query(&index, file, 8050, 10450, 1, silent) == 0);
+    assert(silent[0].min == 0.0f && silent[0].max == 0.0f && silent[0].rms == 0.0f);
+
+    // [0:2] s in 2 columns: the second column covers only silence, the first exactly the tone
+    assert(peak_index_query(&index, file, 0, 16000, 2, silent) == 0);
+    assert(silent[0].max == 0.5f && silent[0].min == -0.5f && fabsf(silent[0].rms - 0.5f) < 1e-6f);
+    assert(silent[1].max == 0.0f && silent[1].min == 0.0f && silent[1].rms == 0.0f);
+
+    // Odd edges mixing coarse buckets, finer buckets and decoded frames
+    assert(peak_index_query(&index, file, 7999, 23001, 1, silent) == 0);
+    assert(silent[0].min == 0.0f && silent[0].max == 0.5f); // Frame 7999 is the last (positive) tone sample
+    assert(peak_index_query(&index, file, 8000, 23001, 1, silent) == 0);
+    assert(silent[0].min == 0.0f && silent[0].max == 0.0f);
+
+    // Without a source the bounds snap to whole buckets: [8300, 10450) reads buckets [8192, 10496)
+    assert(peak_index_query(&index, NULL, 8300, 10450, 1, silent) == 0);
+    assert(silent[0].min == 0.0f && silent[0].max == 0.0f);
+    assert(peak_index_query(&index, NULL, 7990, 8000, 1, silent) == 0); // Snaps to the bucket holding the tone end
+    assert(silent[0].max == 0.5f);
+    assert(peak_index_query(&index, NULL, 23990, 24000, 1, silent) == 0); // Shorter than a bucket at the file end
+    assert(silent[0].min == 0.0f && silent[0].max == 0.0f);
+
+    sf_close(file);
+    peak_index_close(&index);
+
+    // An in-place gain keeps the size and usually the second, the sidecar must still count as stale
+    assert(apply_gain_to_file(input_path, input_path, -6.0) == 0);
+    assert(peak_index_open(input_path, &index, 0) != 0);
+
+    // A missing input reports failure to the caller
+    assert(print_peaks("audio/missing.wav", 0.0, -1.0, 4) != 0);
+
+    printf("----Peak index test passed.\n");
+}
+
+void test_trim_silence() {
+    const char *input_path = "audio/test_tone.wav";
+    const char *silence_path = "audio/test_silence.wav";
+    const char *padded_path = "audio/test_padded.wav";
+    const char *output_path = "audio/test.wav";
+
+    // 1 s of silence, 2 s of tone, 1 s of silence
+    write_test_tone(input_path, 2, 8000, 2.0, 0.5, 100.0);
+    write_test_tone(silence_path, 2, 8000, 1.0, 0.0, 100.0);
+    merge_wav_files(silence_path, input_path, output_path);
+    merge_wav_files(output_path, silence_path, padded_path);
+
+    sf_count_t first_frame, end_frame;
+    assert(find_audio_bounds(padded_path, 0.01f, &first_frame, &end_frame) == 0);
+    assert(first_frame >= 8000 && first_frame < 8010);
+    assert(end_frame > 23990 && end_frame <= 24000);
+
+    trim_silence(padded_path, output_path, -40.0, 100.0);
+    double output_duration = get_audio_length(output_path);
+    assert(output_duration > 1.99 && output_duration <= 2.0);
+
+    printf("----Silence trimming test passed.\n");
+
+    // Silence shorter than min_ms is kept
+    trim_silence(padded_path, output_path, -40.0, 1500.0);
+    assert(get_audio_length(output_path) == get_audio_length(padded_path));
+
+    printf("----Silence trimming test passed for short silence.\n");
+
+    // The copied frames are bit-exact, as with cutting
+    assert(extract_wav_frames("audio/song1.wav", output_path, 1000, 5000) == 0);
+    SF_INFO source_info = {0}, trimmed_info = {0};
+    SNDFILE *source = sf_open("audio/song1.wav", SFM_READ, &source_info);
+    SNDFILE *trimmed = sf_open(output_path, SFM_READ, &trimmed_info);
+    assert(source != NULL && trimmed != NULL);
+    assert(trimmed_info.frames == 4000 && trimmed_info.format == source_info.format);
+    int *expected = malloc(4000 * source_info.channels * sizeof(int));
+    int *actual = malloc(4000 * source_info.channels * sizeof(int));
+    assert(expected != NULL && actual != NULL);
+    assert(sf_seek(source, 1000, SEEK_SET) == 1000);
+    assert(sf_readf_int(source, expected, 4000) == 4000);
+    assert(sf_readf_int(trimmed, actual, 4000) == 4000);
+    assert(memcmp(expected, actual, 4000 * source_info.channels * sizeof(int)) == 0);
+    free(expected);
+    free(actual);
+    sf_close(source);
+    sf_close(trimmed);
+
+    // Detection reports failure to the caller when the input is missing
+    assert(detect_silence(padded_path, -40.0, 100.0) == 0);
+    assert(detect_silence("audio/missing.wav", -40.0, 100.0) != 0);
+
+    remove(silence_path);
+    remove(padded_path);
+}
+
+void test_mix_wav_files() {
+    const char *base_path = "audio/test_tone.wav";
+    const char *overlay_path = "audio/test_overlay.wav";
+    const char *output_path = "audio/test.wav";
+
+    write_test_tone(base_path, 2, 8000, 2.0, 0.25, 100.0);
+    write_test_tone(overlay_path, 1, 8000, 1.0, 0.25, 100.0);
+
+    MixSource source;
+    assert(parse_mix_source("test_overlay.wav@1.5:-6dB", "audio/", &source) == 0);
+    assert(strcmp(source.path, overlay_path) == 0);
+    assert(source.offset == 1.5 && source.gain_db == -6.0);
+    assert(parse_mix_source("test_overlay.wav@-1", "audio/", &source) != 0);
+
+    // The mono overlay at 0 dB starting at 1.5 s extends the stereo base to 2.5 s
+    assert(parse_mix_source("test_overlay.wav@1.5:0", "audio/", &source) == 0);
+    mix_wav_files(base_path, &source, 1, output_path, NULL, 0);
+
+    SF_INFO sf_info;
+    SNDFILE *output_file = sf_open(output_path, SFM_READ, &sf_info);
+    assert(output_file != NULL);
+    assert(sf_info.channels == 2 && sf_info.frames == 20000);
+
+    // Both signals are in phase, so the overlap doubles the amplitude
+    float *samples = malloc(sf_info.frames * 2 * sizeof(float));
+    assert(samples != NULL);
+    assert(sf_readf_float(output_file, samples, sf_info.frames) == sf_info.frames);
+    float before = 0.0f, during = 0.0f, after = 0.0f;
+    for (sf_count_t i = 0; i < sf_info.frames; ++i) {
+        float magnitude = fabsf(samples[2 * i]);
+        if (i < 12000 && magnitude > before) before = magnitude;
+        if (i >= 12000 && i < 16000 && magnitude > during) during = magnitude;
+        if (i >= 16000 && magnitude > after) after = magnitude;
+    }
+    assert(fabsf(before - 0.25f) < 1e-3f);
+    assert(fabsf(during - 0.5f) < 1e-3f);
+    assert(fabsf(after - 0.25f) < 1e-3f);
+    free(samples);
+    sf_close(output_file);
+
+    printf("----Mixing test passed.\n");
+
+    // An overlay layout without a default matrix is rejected before any output is written
+    const char *quad_path = "audio/test_quad.wav";
+    write_test_tone(quad_path, 4, 8000, 1.0, 0.25, 100.0);
+    write_test_tone(overlay_path, 6, 8000, 1.0, 0.25, 100.0);
+    assert(parse_mix_source("test_overlay.wav@0:0", "audio/", &source) == 0);
+    remove(output_path);
+    assert(mix_wav_files(quad_path, &source, 1, output_path, NULL, 0) != 0);
+    assert(sf_open(output_path, SFM_READ, &sf_info) == NULL);
+    remove(quad_path);
+
+    // The soft clipper keeps overshooting sums below full scale
+    float loud[5] = {0.5f, 1.5f, -3.0f, 0.95f, -0.2f};
+    soft_clip_samples(loud, 5);
+    assert(loud[0] == 0.5f && loud[4] == -0.2f);
+    assert(loud[1] <= 1.0f && loud[1] > 0.9f);
+    assert(loud[2] >= -1.0f && loud[2] < -0.9f);
+    assert(loud[3] > 0.9f && loud[3] < 0.95f);
+
+    printf("----Soft clipping test passed.\n");
+
+    remove(overlay_path);
+}
+
+void test_apply_envelope() {
+    const char *input_path = "audio/test_tone.wav";
+    const char *envelope_path = "audio/test.env";
+    const char *output_path = "audio/test.wav";
+
+    // Constant 0.5 level so the output shows the gain curve directly
+    SF_INFO sf_info = {0};
+    sf_info.channels = 2;
+    sf_info.samplerate = 8000;
+    sf_info.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+    SNDFILE *file = sf_open(input_path, SFM_WRITE, &sf_info);
+    assert(file != NULL);
+    float frame[2] = {0.5f, 0.5f};
+    for (int i = 0; i < 24000; ++i) {
+        sf_writef_float(file, frame, 1);
+    }
+    sf_close(file);
+
+    // 0 dB for 1 s, linear ramp down to -6 dB, hold, then back to 0 dB in dB steps
+    FILE *envelope_file = fopen(envelope_path, "w");
+    assert(envelope_file != NULL);
+    fprintf(envelope_file, "# time gain curve\n1.0 0 linear\n1.5 -6.0206 hold\n2.0 -6.0206 exp\n2.5 0\n");
+    fclose(envelope_file);
+
+    GainEnvelope envelope;
+    assert(envelope_load(&envelope, envelope_path) == 0);
+    assert(envelope.count == 4);
+    assert(envelope_is_unity(&envelope, 8000, 0, 8000));
+    assert(!envelope_is_unity(&envelope, 8000, 0, 8001));
+    assert(envelope_is_unity(&envelope, 8000, 20000, 24000));
+    envelope_free(&envelope);
+
+    apply_envelope(input_path, output_path, envelope_path);
+
+    file = sf_open(output_path, SFM_READ, &sf_info);
+    assert(file != NULL && sf_info.frames == 24000);
+    float *samples = malloc(24000 * 2 * sizeof(float));
+    assert(samples != NULL);
+    assert(sf_readf_float(file, samples, 24000) == 24000);
+    sf_close(file);
+
+    assert(samples[2 * 4000] == 0.5f);                                // Untouched
+    assert(fabsf(samples[2 * 10000] - 0.5f * 0.75f) < 1e-3f);         // Half way down the linear ramp
+    assert(fabsf(samples[2 * 14000 + 1] - 0.25f) < 1e-3f);            // Hold at -6 dB
+    assert(fabsf(samples[2 * 18000] - 0.5f * powf(10.0f, -3.0103f / 20.0f)) < 1e-3f); // -3 dB half way up the exp ramp
+    assert(samples[2 * 22000] == 0.5f);                               // Back to untouched
+
+    // Non-finite values and times past ENVELOPE_MAX_SECONDS are rejected
+    const char *bad_lines[] = {"nan 0\n", "inf 0\n", "1.0 nan\n", "1.0 inf\n", "0 0\n1.0 -inf exp\n", "1e300 0\n"};
+    for (int i = 0; i < 6; ++i) {
+        envelope_file = fopen(envelope_path, "w");
+        assert(envelope_file != NULL);
+        fputs(bad_lines[i], envelope_file);
+        fclose(envelope_file);
+        assert(envelope_load(&envelope, envelope_path) != 0);
+    }
+
+    // An exp ramp out of a mute far below the floor still rises from the floor
+    envelope_file = fopen(envelope_path, "w");
+    assert(envelope_file != NULL);
+    fprintf(envelope_file, "1.0 -1000 exp\n2.0 0\n");
+    fclose(envelope_file);
+    assert(apply_envelope(input_path, output_path, envelope_path) == 0);
+
+    file = sf_open(output_path, SFM_READ, &sf_info);
+    assert(file != NULL);
+    assert(sf_readf_float(file, samples, 24000) == 24000);
+    sf_close(file);
+
+    assert(samples[2 * 4000] == 0.0f);                                 // Flat lead-in stays muted
+    assert(fabsf(samples[2 * 12000] / (0.5f * powf(10.0f, -72.0f / 20.0f)) - 1.0f) < 1e-2f); // Half way up from -144 dB
+    assert(fabsf(samples[2 * 15999] - 0.5f) < 2e-3f);                 // One step short of 0 dB
+    assert(samples[2 * 16000] == 0.5f);
+
+    // A staircase of many held breakpoints spanning several blocks lands every step on its own gain
+    envelope_file = fopen(envelope_path, "w");
+    assert(envelope_file != NULL);
+    for (int i = 0; i < 150; ++i) {
+        fprintf(envelope_file, "%.3f %s hold\n", i * 0.02, (i % 2) ? "-6.0206" : "0");
+    }
+    fclose(envelope_file);
+    assert(apply_envelope(input_path, output_path, envelope_path) == 0);
+
+    file = sf_open(output_path, SFM_READ, &sf_info);
+    assert(file != NULL);
+    assert(sf_readf_float(file, samples, 24000) == 24000);
+    sf_close(file);
+    for (int i = 0; i < 150; ++i) {
+        const float expected = (i % 2) ? 0.25f : 0.5f;
+        assert(fabsf(samples[2 * (i * 160 + 80)] - expected) < 1e-4f);
+    }
+    free(samples);
+
+    remove(envelope_path);
+    printf("----Envelope test passed.\n");
+}
+
+static int cached_fade_runs = 0;
+
+// Stand-in for the command line: fade-in "<input>" "<time>" "--name" "<output>" inside audio/
+static int run_cached_fade(int argc, char *argv[]) {
+    char input_path[256];
+    char output_path[256];
+    assert(argc == 6);
+    snprintf(input_path, sizeof(input_path), "audio/%s", argv[2]);
+    snprintf(output_path, sizeof(output_path), "audio/%s", argv[5]);
+    cached_fade_runs++;
+    return add_fade_in(input_path, output_path, atof(argv[3]));
+}
+
+void test_result_cache() {
+    const char *cache_dir = "audio/test_cache";
+    char *job[] = {"ggsound", "--fade-in", "test_tone.wav", "0.5", "--name", "test.wav", NULL};
+    char *other_job[] = {"ggsound", "--fade-in", "test_tone.wav", "0.25", "--name", "test.wav", NULL};
+    char *in_place_job[] = {"ggsound", "--fade-in", "test.wav", "0.5", "--name", "test.wav", NULL};
+    char *failing_job[] = {"ggsound", "--fade-in", "non_existent_file.wav", "0.5", "--name", "test_failed.wav", NULL};
+    char output_path[256];
+    char key[RESULT_CACHE_KEY_LENGTH + 1];
+    ResultCache cache;
+    ResultCacheStats stats;
+
+    write_test_tone("audio/test_tone.wav", 1, 8000, 1.0, 0.5, 100.0);
+    assert(result_cache_open(&cache, cache_dir, 1024LL * 1024 * 1024) == 0);
+    assert(result_cache_is_cacheable("--mix") && !result_cache_is_cacheable("--analyze"));
+
+    result_cache_output_path(6, job, "audio/", output_path, sizeof(output_path));
+    assert(strcmp(output_path, "audio/test.wav") == 0);
+    assert(result_cache_key(6, in_place_job, "audio/", output_path, key, sizeof(key)) == 1);
+
+    // First run computes, the identical second one is restored from the cache
+    cached_fade_runs = 0;
+    assert(result_cache_run(&cache, 6, job, "audio/", run_cached_fade) == 0);
+    assert(cached_fade_runs == 1);
+    remove("audio/test.wav");
+    assert(result_cache_run(&cache, 6, job, "audio/", run_cached_fade) == 0);
+    assert(cached_fade_runs == 1);
+    assert(get_audio_length("audio/test.wav") == 1.0);
+
+    // Other parameters or a rewritten input are different jobs
+    assert(result_cache_run(&cache, 6, other_job, "audio/", run_cached_fade) == 0);
+    assert(cached_fade_runs == 2);
+    write_test_tone("audio/test_tone.wav", 1, 8000, 1.0, 0.5, 100.0);
+    assert(result_cache_run(&cache, 6, job, "audio/", run_cached_fade) == 0);
+    assert(cached_fade_runs == 3);
+
+    // Rewriting a restored output must leave the stored entry intact
+    add_fade_out("audio/test_tone.wav", "audio/test.wav", 0.5);
+    assert(result_cache_run(&cache, 6, job, "audio/", run_cached_fade) == 0);
+    assert(cached_fade_runs == 3);
+    SF_INFO sf_info = {0};
+    SNDFILE *file = sf_open("audio/test.wav", SFM_READ, &sf_info);
+    assert(file != NULL);
+    float first_sample = 1.0f;
+    assert(sf_readf_float(file, &first_sample, 1) == 1);
+    assert(first_sample == 0.0f);
+    sf_close(file);
+
+    // A copy that cannot be made leaves the previous destination in place
+    assert(materialize_file("audio/test_cache/missing.out", "audio/test.wav") != 0);
+    assert(get_audio_length("audio/test.wav") > 0);
+
+    // A failed job is neither stored nor leaves an output
+    assert(result_cache_run(&cache, 6, failing_job, "audio/", run_cached_fade) != 0);
+    assert(get_audio_length("audio/test_failed.wav") < 0);
+
+    result_cache_read_stats(&cache, &stats);
+    assert(stats.hits == 2 && stats.misses == 4 && stats.evictions == 0);
+
+    // A zero limit evicts every entry
+    cache.max_bytes = 0;
+    assert(result_cache_evict(&cache) == 3);
+    result_cache_read_stats(&cache, &stats);
+    assert(stats.evictions == 3);
+
+    remove("audio/test_cache/stats");
+    remove(cache_dir);
+    printf("----Result cache test passed.\n");
+}
 
 int main() {
     printf("\n");
@@ -214,10 +916,34 @@ int main() {
     printf("----Testing fade-in and fade-out\n");
     test_add_fade_in();
     test_add_fade_out();
+    test_audio_block_roundtrip();
+    test_fade_in_place();
     printf("\n");
     printf("----Testing merging...\n");
     test_merge_wav_files();
     printf("\n");
+    printf("----Testing channel remapping...\n");
+    test_channel_matrix_kernels();
+    test_remap_channels();
+    printf("\n");
+    printf("----Testing analysis and normalization...\n");
+    test_analyze_and_normalize();
+    printf("\n");
+    printf("----Testing peak index...\n");
+    test_peak_index();
+    printf("\n");
+    printf("----Testing silence trimming...\n");
+    test_trim_silence();
+    printf("\n");
+    printf("----Testing mixing...\n");
+    test_mix_wav_files();
+    printf("\n");
+    printf("----Testing gain envelopes...\n");
+    test_apply_envelope();
+    printf("\n");
+    printf("----Testing result cache...\n");
+    test_result_cache();
+    printf("\n");
     printf("All tests passed.\n");
 
     return 0;